@@ -3,48 +3,156 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif
+
+// build with -DMPQ_TRACK_ALLOCS to count every malloc/realloc this file makes (queue arrays,
+// segments, messages); test_Reserve reads it around a steady-state loop
+#ifdef MPQ_TRACK_ALLOCS
+static _Atomic long heapAllocations = 0;
+static void* countedMalloc(size_t n) { ++heapAllocations; return malloc(n); }
+static void* countedRealloc(void* p, size_t n) { ++heapAllocations; return realloc(p, n); }
+#define malloc(n) countedMalloc(n)
+#define realloc(p, n) countedRealloc(p, n)
+#endif
 
 /* ========= Message ========= */
+// one block per message: header plus inline text (flexible array member), so
+// creating a message is one allocation and reading it is no extra pointer chase.
+// next is an intrusive link owned by whichever list holds the message (see IntrusiveMessageQueue).
 typedef struct Message {
-    char *msgstr;
+    struct Message* next;
+    size_t len;     // bytes of text, not counting the NUL; MESSAGE_NO_TEXT for a NULL message
+    char msgstr[];  // len bytes followed by '\0'
 } Message;
 
-Message* Message_new(const char* s) {
-    Message* m = (Message*)malloc(sizeof(Message));
+#define MESSAGE_NO_TEXT ((size_t)-1)
+
+// small-message fast path: texts up to MESSAGE_SMALL_TEXT bytes (NUL included)
+// share one block size, and freed blocks are kept on a per-thread free list
+#ifndef MESSAGE_SMALL_TEXT
+#define MESSAGE_SMALL_TEXT 48
+#endif
+#ifndef MESSAGE_POOL_LIMIT
+#define MESSAGE_POOL_LIMIT 1024
+#endif
+static _Thread_local Message* messagePool = NULL;
+static _Thread_local int messagePoolSize = 0;
+
+// a thread's pool goes back to the allocator when the thread exits: the first block it pools
+// arms a tss destructor that runs Message_releasePool() there. blocks deleted by a thread other
+// than the one that made them join the deleting thread's pool and leave with it. the main thread
+// (and any thread without C11 threads support) calls Message_releasePool() itself.
+void Message_releasePool(void);
+#ifndef __STDC_NO_THREADS__
+static tss_t messagePoolKey;
+static once_flag messagePoolKeyOnce = ONCE_FLAG_INIT;
+static _Thread_local int messagePoolArmed = 0;
+static void Message_poolThreadExit(void* unused) { (void)unused; Message_releasePool(); }
+static void Message_createPoolKey(void) {
+    if (tss_create(&messagePoolKey, Message_poolThreadExit) != thrd_success) exit(1);
+}
+static void Message_armPool(void) {
+    if (messagePoolArmed) return;
+    call_once(&messagePoolKeyOnce, Message_createPoolKey);
+    tss_set(messagePoolKey, &messagePoolArmed); // any non-NULL value makes the destructor run
+    messagePoolArmed = 1;
+}
+#else
+#define Message_armPool() ((void)0)
+#endif
+
+static Message* Message_alloc(size_t textBytes) {
+    if (textBytes <= MESSAGE_SMALL_TEXT) {
+        Message* m = messagePool;
+        if (m) {
+            messagePool = m->next;
+            messagePoolSize--;
+            m->next = NULL;
+            return m;
+        }
+        textBytes = MESSAGE_SMALL_TEXT;
+    }
+    Message* m = (Message*)malloc(sizeof(Message) + textBytes);
     if (!m) exit(1);
-    if (s) {
-        size_t n = strlen(s) + 1;
-        m->msgstr = (char*)malloc(n);
-        if (!m->msgstr) exit(1);
-        memcpy(m->msgstr, s, n);
-    } else {
-        m->msgstr = NULL;
+    m->next = NULL;
+    return m;
+}
+
+// length-aware constructor: copies exactly n bytes (embedded NULs allowed) without a strlen
+Message* Message_newN(const char* s, size_t n) {
+    if (!s) {
+        assert(n == 0);
+        Message* m = Message_alloc(0);
+        m->len = MESSAGE_NO_TEXT;
+        m->msgstr[0] = '\0';
+        return m;
     }
+    Message* m = Message_alloc(n + 1);
+    m->len = n;
+    memcpy(m->msgstr, s, n);
+    m->msgstr[n] = '\0';
     return m;
 }
-const char* Message_get(const Message* m) { return m ? m->msgstr : NULL; }
+Message* Message_new(const char* s) { return Message_newN(s, s ? strlen(s) : 0); }
+const char* Message_get(const Message* m) {
+    return m && m->len != MESSAGE_NO_TEXT ? m->msgstr : NULL;
+}
+size_t Message_len(const Message* m) { return m && m->len != MESSAGE_NO_TEXT ? m->len : 0; }
 void Message_delete(Message* m) {
     if (!m) return;
-    free(m->msgstr);
+    size_t textBytes = m->len == MESSAGE_NO_TEXT ? 0 : m->len + 1;
+    if (textBytes <= MESSAGE_SMALL_TEXT && messagePoolSize < MESSAGE_POOL_LIMIT) {
+        Message_armPool();
+        m->next = messagePool;
+        messagePool = m;
+        messagePoolSize++;
+        return;
+    }
     free(m);
 }
+// return this thread's cached small blocks to the allocator
+void Message_releasePool(void) {
+    while (messagePool) {
+        Message* m = messagePool;
+        messagePool = m->next;
+        free(m);
+    }
+    messagePoolSize = 0;
+}
 
 /* ========= MessageQueue (FIFO, dynamic capacity growth) ========= */
-// growable array, enqueue/dequeue FIFO, owns Messages when destroyed
+// ring buffer: live messages are slots [head, head + size) modulo capacity,
+// capacity is a power of two so wrapping is a mask. Owns Messages when destroyed.
+// with MessageQueue_setShrinkAfter(q, n), capacity halves after n consecutive dequeues
+// under 1/4 full (never below the default); MessageQueue_trim shrinks it right away.
+// MessageQueue_reserve(q, n) preallocates n slots and keeps capacity from shrinking below
+// them, so up to n queued messages never touch the allocator.
 typedef struct MessageQueue {
     Message** messages;
+    int head;
     int size;
     int capacity;
+    int reserved;    // shrink floor set by MessageQueue_reserve
+    int shrinkAfter; // 0 = never shrink on dequeue
+    int lowStreak;
 } MessageQueue;
 
 #ifndef DEFAULT_QUEUE_CAPACITY
 #define DEFAULT_QUEUE_CAPACITY 16
 #endif
+_Static_assert(DEFAULT_QUEUE_CAPACITY > 0 && (DEFAULT_QUEUE_CAPACITY & (DEFAULT_QUEUE_CAPACITY - 1)) == 0,
+               "DEFAULT_QUEUE_CAPACITY must be a power of two");
 
 MessageQueue* MessageQueue_new(void) {
     MessageQueue* q = (MessageQueue*)malloc(sizeof(MessageQueue));
     if (!q) exit(1);
+    q->head = 0;
     q->size = 0;
+    q->reserved = 0;
+    q->shrinkAfter = 0;
+    q->lowStreak = 0;
     q->capacity = DEFAULT_QUEUE_CAPACITY;
     q->messages = (Message**)malloc(sizeof(Message*) * q->capacity);
     if (!q->messages) exit(1);
@@ -53,54 +161,302 @@ MessageQueue* MessageQueue_new(void) {
 
 static void MessageQueue_ensureCapacity(MessageQueue* q) {
     if (q->size == q->capacity) {
+        int oldCap = q->capacity;
         q->capacity *= 2;
         Message** nm = (Message**)realloc(q->messages, sizeof(Message*) * q->capacity);
         if (!nm) exit(1);
         q->messages = nm;
+        // realloc kept slots [0, oldCap); the run that wrapped to [0, head) must
+        // follow [head, oldCap) to stay contiguous modulo the new capacity
+        if (q->head > 0) memcpy(q->messages + oldCap, q->messages, sizeof(Message*) * q->head);
+    }
+}
+
+// moves the live run to a fresh array of newCap slots (power of two, >= size), head at 0
+static void MessageQueue_resize(MessageQueue* q, int newCap) {
+    Message** nm = (Message**)malloc(sizeof(Message*) * newCap);
+    if (!nm) exit(1);
+    int first = q->capacity - q->head < q->size ? q->capacity - q->head : q->size;
+    memcpy(nm, q->messages + q->head, sizeof(Message*) * first);
+    memcpy(nm + first, q->messages, sizeof(Message*) * (q->size - first));
+    free(q->messages);
+    q->messages = nm;
+    q->capacity = newCap;
+    q->head = 0;
+}
+
+// shrink policy, run after each dequeue (or batch of them)
+static void MessageQueue_maybeShrink(MessageQueue* q) {
+    if (!q->shrinkAfter || q->capacity <= DEFAULT_QUEUE_CAPACITY || q->capacity / 2 < q->reserved) return;
+    if (q->size >= q->capacity / 4) q->lowStreak = 0;
+    else if (++q->lowStreak >= q->shrinkAfter) {
+        MessageQueue_resize(q, q->capacity / 2);
+        q->lowStreak = 0;
     }
 }
 
 void MessageQueue_enqueue(MessageQueue* q, Message* m) {
     assert(q && m);
     MessageQueue_ensureCapacity(q);
-    q->messages[q->size++] = m;
+    q->messages[(q->head + q->size) & (q->capacity - 1)] = m;
+    q->size++;
 }
 
 Message* MessageQueue_dequeue(MessageQueue* q) {
     if (!q || q->size == 0) return NULL;
-    Message* m = q->messages[0];
-    // shift (simple and clear; fine for teaching; a ring buffer would be O(1))
-    for (int i = 1; i < q->size; ++i) q->messages[i - 1] = q->messages[i];
+    Message* m = q->messages[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
     q->size--;
+    MessageQueue_maybeShrink(q);
     return m; // caller becomes owner
 }
 
+// appends n messages with one capacity check and at most two memcpy calls
+void MessageQueue_enqueue_n(MessageQueue* q, Message* const* ms, int n) {
+    assert(q && (ms || n == 0) && n >= 0);
+    if (n == 0) return;
+    if (q->size + n > q->capacity) {
+        int want = q->capacity;
+        while (want < q->size + n) want *= 2;
+        MessageQueue_resize(q, want);
+    }
+    int tail = (q->head + q->size) & (q->capacity - 1);
+    int first = q->capacity - tail < n ? q->capacity - tail : n;
+    memcpy(q->messages + tail, ms, sizeof(Message*) * first);
+    memcpy(q->messages, ms + first, sizeof(Message*) * (n - first));
+    q->size += n;
+}
+
+// moves up to maxN of the oldest messages into out; returns how many (caller owns them)
+int MessageQueue_dequeue_n(MessageQueue* q, Message** out, int maxN) {
+    if (!q || maxN <= 0 || q->size == 0) return 0;
+    int n = q->size < maxN ? q->size : maxN;
+    int first = q->capacity - q->head < n ? q->capacity - q->head : n;
+    memcpy(out, q->messages + q->head, sizeof(Message*) * first);
+    memcpy(out + first, q->messages, sizeof(Message*) * (n - first));
+    q->head = (q->head + n) & (q->capacity - 1);
+    q->size -= n;
+    MessageQueue_maybeShrink(q);
+    return n;
+}
+
+void MessageQueue_setShrinkAfter(MessageQueue* q, int dequeues) {
+    assert(q && dequeues >= 0);
+    q->shrinkAfter = dequeues;
+    q->lowStreak = 0;
+}
+
+// grows capacity to hold n messages now and keeps it at least that large from then on
+void MessageQueue_reserve(MessageQueue* q, int n) {
+    assert(q && n >= 0);
+    int want = q->capacity;
+    while (want < n) want *= 2;
+    if (want > q->capacity) MessageQueue_resize(q, want);
+    q->reserved = n;
+}
+
+// shrinks capacity to the smallest power of two holding the current size, not below the
+// default or the reservation
+void MessageQueue_trim(MessageQueue* q) {
+    if (!q) return;
+    int want = DEFAULT_QUEUE_CAPACITY;
+    while (want < q->size || want < q->reserved) want *= 2;
+    if (want < q->capacity) MessageQueue_resize(q, want);
+}
+
 int MessageQueue_size(const MessageQueue* q) { return q ? q->size : 0; }
 int MessageQueue_capacity(const MessageQueue* q) { return q ? q->capacity : 0; }
 
 void MessageQueue_delete(MessageQueue* q) {
     if (!q) return;
     for (int i = 0; i < q->size; ++i) {
-        Message_delete(q->messages[i]); // own & free undelivered messages
+        Message_delete(q->messages[(q->head + i) & (q->capacity - 1)]); // own & free undelivered messages
     }
     free(q->messages);
     free(q);
 }
 
+/* ========= SegmentedMessageQueue (FIFO over 4 KiB blocks) ========= */
+// a linked list of fixed 4 KiB segments of Message pointers: growing links one more segment
+// instead of realloc-copying the whole array, overshoot is at most one segment, and drained
+// segments go to a small spare list for reuse; spares beyond SEGMENT_SPARE_LIMIT are freed,
+// so memory follows the queue back down.
+#ifndef SEGMENT_BYTES
+#define SEGMENT_BYTES 4096
+#endif
+#ifndef SEGMENT_SPARE_LIMIT
+#define SEGMENT_SPARE_LIMIT 4
+#endif
+#define SEGMENT_SLOTS ((int)((SEGMENT_BYTES - sizeof(void*)) / sizeof(Message*)))
+
+typedef struct Segment {
+    struct Segment* next;
+    Message* slots[SEGMENT_SLOTS];
+} Segment;
+
+_Static_assert(sizeof(Segment) <= SEGMENT_BYTES, "a segment fills one block");
+
+typedef struct SegmentedMessageQueue {
+    Segment* head;  // oldest segment; messages start at slot headPos
+    Segment* tail;  // newest segment; next message goes to slot tailPos
+    int headPos;
+    int tailPos;
+    int size;
+    int segments;   // in use, spares not counted
+    Segment* spare; // drained segments kept for reuse
+    int spareCount;
+} SegmentedMessageQueue;
+
+static Segment* SegmentedMessageQueue_takeSegment(SegmentedMessageQueue* q) {
+    Segment* sg = q->spare;
+    if (sg) {
+        q->spare = sg->next;
+        q->spareCount--;
+    } else {
+        sg = (Segment*)malloc(sizeof(Segment));
+        if (!sg) exit(1);
+    }
+    sg->next = NULL;
+    q->segments++;
+    return sg;
+}
+
+static void SegmentedMessageQueue_dropSegment(SegmentedMessageQueue* q, Segment* sg) {
+    q->segments--;
+    if (q->spareCount < SEGMENT_SPARE_LIMIT) {
+        sg->next = q->spare;
+        q->spare = sg;
+        q->spareCount++;
+    } else {
+        free(sg);
+    }
+}
+
+SegmentedMessageQueue* SegmentedMessageQueue_new(void) {
+    SegmentedMessageQueue* q = (SegmentedMessageQueue*)malloc(sizeof(SegmentedMessageQueue));
+    if (!q) exit(1);
+    q->spare = NULL;
+    q->spareCount = 0;
+    q->segments = 0;
+    q->head = q->tail = SegmentedMessageQueue_takeSegment(q);
+    q->headPos = q->tailPos = 0;
+    q->size = 0;
+    return q;
+}
+
+void SegmentedMessageQueue_enqueue(SegmentedMessageQueue* q, Message* m) {
+    assert(q && m);
+    if (q->tailPos == SEGMENT_SLOTS) {
+        Segment* sg = SegmentedMessageQueue_takeSegment(q);
+        q->tail->next = sg;
+        q->tail = sg;
+        q->tailPos = 0;
+    }
+    q->tail->slots[q->tailPos++] = m;
+    q->size++;
+}
+
+Message* SegmentedMessageQueue_dequeue(SegmentedMessageQueue* q) {
+    if (!q || q->size == 0) return NULL;
+    if (q->headPos == SEGMENT_SLOTS) { // head segment fully consumed: recycle it
+        Segment* done = q->head;
+        q->head = done->next;
+        q->headPos = 0;
+        SegmentedMessageQueue_dropSegment(q, done);
+    }
+    Message* m = q->head->slots[q->headPos++];
+    q->size--;
+    if (q->size == 0 && q->head == q->tail) q->headPos = q->tailPos = 0; // reuse the lone segment from the start
+    return m; // caller becomes owner
+}
+
+int SegmentedMessageQueue_size(const SegmentedMessageQueue* q) { return q ? q->size : 0; }
+int SegmentedMessageQueue_segments(const SegmentedMessageQueue* q) { return q ? q->segments : 0; }
+
+void SegmentedMessageQueue_delete(SegmentedMessageQueue* q) {
+    if (!q) return;
+    Message* m;
+    while ((m = SegmentedMessageQueue_dequeue(q)) != NULL) Message_delete(m);
+    free(q->head);
+    while (q->spare) {
+        Segment* sg = q->spare;
+        q->spare = sg->next;
+        free(sg);
+    }
+    free(q);
+}
+
+/* ========= IntrusiveMessageQueue (FIFO through Message.next) ========= */
+// singly linked through each Message's own link field: no pointer array, so enqueue and
+// dequeue never allocate or realloc, and moving a message to another queue (e.g. another
+// priority level) is two pointer updates. a message sits in at most one list at a time.
+typedef struct IntrusiveMessageQueue {
+    Message* head;
+    Message* tail;
+    int size;
+} IntrusiveMessageQueue;
+
+void IntrusiveMessageQueue_init(IntrusiveMessageQueue* q) {
+    q->head = q->tail = NULL;
+    q->size = 0;
+}
+
+void IntrusiveMessageQueue_enqueue(IntrusiveMessageQueue* q, Message* m) {
+    assert(q && m && m->next == NULL);
+    if (q->tail) q->tail->next = m;
+    else q->head = m;
+    q->tail = m;
+    q->size++;
+}
+
+Message* IntrusiveMessageQueue_dequeue(IntrusiveMessageQueue* q) {
+    if (!q || !q->head) return NULL;
+    Message* m = q->head;
+    q->head = m->next;
+    if (!q->head) q->tail = NULL;
+    m->next = NULL;
+    q->size--;
+    return m; // caller becomes owner
+}
+
+int IntrusiveMessageQueue_size(const IntrusiveMessageQueue* q) { return q ? q->size : 0; }
+
+// frees undelivered messages; the queue itself may live on the stack or inside another struct
+void IntrusiveMessageQueue_clear(IntrusiveMessageQueue* q) {
+    Message* m;
+    while ((m = IntrusiveMessageQueue_dequeue(q)) != NULL) Message_delete(m);
+}
+
 /* ========= MessagePriorityQueue ========= */
 // array of MessageQueue*, one per priority; dequeue scans from highest  :contentReference[oaicite:4]{index=4}
+// instead of probing each level, a bitmask of non-empty levels selects the highest ready one
 typedef enum { PRIORITY_HIGHEST = 0, PRIORITY_HIGH, PRIORITY_LOW, PRIORITY_LOWEST, PRIORITY_COUNT } Priority;
 
 typedef struct MessagePriorityQueue {
     MessageQueue** queues; // size PRIORITY_COUNT
+    unsigned ready;        // bit p set <=> queues[p] non-empty
 } MessagePriorityQueue;
 
+_Static_assert(PRIORITY_COUNT <= 32, "ready mask is one unsigned");
+
+// index of the lowest set bit; x must be non-zero
+static int MPQ_ctz(unsigned x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1u)) { x >>= 1; ++n; }
+    return n;
+#endif
+}
+
 MessagePriorityQueue* MPQ_new(void) {
     MessagePriorityQueue* pq = (MessagePriorityQueue*)malloc(sizeof(MessagePriorityQueue));
     if (!pq) exit(1);
     pq->queues = (MessageQueue**)malloc(sizeof(MessageQueue*) * PRIORITY_COUNT);
     if (!pq->queues) exit(1);
     for (int p = 0; p < PRIORITY_COUNT; ++p) pq->queues[p] = MessageQueue_new();
+    pq->ready = 0;
     return pq;
 }
 
@@ -118,15 +474,47 @@ void MPQ_enqueue(MessagePriorityQueue* pq, Message* m, Priority prio) {
     assert(pq && m);
     assert(prio >= PRIORITY_HIGHEST && prio < PRIORITY_COUNT);
     MessageQueue_enqueue(pq->queues[prio], m);
+    pq->ready |= 1u << prio;
 }
 
 Message* MPQ_dequeue(MessagePriorityQueue* pq) {
-    if (!pq) return NULL;
-    for (int p = PRIORITY_HIGHEST; p < PRIORITY_COUNT; ++p) {
-        Message* m = MessageQueue_dequeue(pq->queues[p]);
-        if (m) return m;
+    if (!pq || !pq->ready) return NULL;
+    int p = MPQ_ctz(pq->ready);
+    Message* m = MessageQueue_dequeue(pq->queues[p]);
+    if (MessageQueue_size(pq->queues[p]) == 0) pq->ready &= pq->ready - 1; // clear bit p
+    return m;
+}
+
+int MPQ_isEmpty(const MessagePriorityQueue* pq) { return !pq || pq->ready == 0; }
+
+void MPQ_enqueue_n(MessagePriorityQueue* pq, Message* const* ms, int n, Priority prio) {
+    assert(pq && prio >= PRIORITY_HIGHEST && prio < PRIORITY_COUNT);
+    if (n <= 0) return;
+    MessageQueue_enqueue_n(pq->queues[prio], ms, n);
+    pq->ready |= 1u << prio;
+}
+
+// fills out with up to maxN messages, highest level first, FIFO within a level
+int MPQ_dequeue_n(MessagePriorityQueue* pq, Message** out, int maxN) {
+    if (!pq) return 0;
+    int got = 0;
+    while (got < maxN && pq->ready) {
+        int p = MPQ_ctz(pq->ready);
+        got += MessageQueue_dequeue_n(pq->queues[p], out + got, maxN - got);
+        if (MessageQueue_size(pq->queues[p]) == 0) pq->ready &= pq->ready - 1;
     }
-    return NULL;
+    return got;
+}
+
+void MPQ_setShrinkAfter(MessagePriorityQueue* pq, int dequeues) {
+    for (int p = 0; p < PRIORITY_COUNT; ++p) MessageQueue_setShrinkAfter(pq->queues[p], dequeues);
+}
+void MPQ_reserve(MessagePriorityQueue* pq, Priority prio, int n) {
+    assert(pq && prio >= PRIORITY_HIGHEST && prio < PRIORITY_COUNT);
+    MessageQueue_reserve(pq->queues[prio], n);
+}
+void MPQ_trim(MessagePriorityQueue* pq) {
+    for (int p = 0; p < PRIORITY_COUNT; ++p) MessageQueue_trim(pq->queues[p]);
 }
 
 int MPQ_sizePriority(const MessagePriorityQueue* pq, Priority prio) {
@@ -147,8 +535,49 @@ static void test_Message(void) {
     assert(Message_get(b) == NULL);
     Message_delete(a);
     Message_delete(b);
+
+    // small blocks are recycled; large texts take their own exact-size block
+    Message* c = Message_new("reuse");
+    Message_delete(c);
+    Message* d = Message_new("pooled");
+    assert(d == c && strcmp(Message_get(d), "pooled") == 0);
+    char big[200];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    Message* e = Message_new(big);
+    assert(strcmp(Message_get(e), big) == 0);
+    Message_delete(d);
+    Message_delete(e);
+
+    // binary-safe: embedded NUL survives and the length is stored, not rescanned
+    const char bin[] = {'a', '\0', 'b'};
+    Message* f = Message_newN(bin, sizeof(bin));
+    assert(Message_len(f) == 3 && memcmp(Message_get(f), bin, 3) == 0);
+    assert(Message_len(NULL) == 0);
+    Message_delete(f);
 }
 
+#ifndef __STDC_NO_THREADS__
+// pools small blocks on its own thread, some of them made by main, then exits without
+// calling Message_releasePool(); LeakSanitizer builds fail if the pool is not drained
+static int poolingThread(void* arg) {
+    Message** fromMain = (Message**)arg;
+    for (int i = 0; i < 8; ++i) Message_delete(fromMain[i]);
+    for (int i = 0; i < 100; ++i) Message_delete(Message_new("worker"));
+    return 0;
+}
+static void test_MessagePoolThreadExit(void) {
+    Message* fromMain[8];
+    for (int i = 0; i < 8; ++i) fromMain[i] = Message_new("main");
+    thrd_t t;
+    int rc = thrd_create(&t, poolingThread, fromMain);
+    assert(rc == thrd_success);
+    rc = thrd_join(t, NULL);
+    assert(rc == thrd_success);
+    (void)rc;
+}
+#endif
+
 static void test_MessageQueue(void) {
     MessageQueue* q = MessageQueue_new();
     // growth
@@ -169,7 +598,150 @@ static void test_MessageQueue(void) {
         Message_delete(m);
     }
     assert(MessageQueue_dequeue(q) == NULL);
+
+    // wraparound: move head off slot 0, then grow while the live run is split
+    for (int i = 0; i < 5; ++i) MessageQueue_enqueue(q, Message_new("x"));
+    for (int i = 0; i < 5; ++i) Message_delete(MessageQueue_dequeue(q));
+    int cap = MessageQueue_capacity(q);
+    for (int i = 0; i < cap + 1; ++i) {
+        char buf[32]; snprintf(buf, sizeof(buf), "w%d", i);
+        MessageQueue_enqueue(q, Message_new(buf));
+    }
+    assert(MessageQueue_capacity(q) == cap * 2);
+    for (int i = 0; i < cap; ++i) {
+        char expect[32]; snprintf(expect, sizeof(expect), "w%d", i);
+        Message* m = MessageQueue_dequeue(q);
+        assert(m && strcmp(Message_get(m), expect) == 0);
+        Message_delete(m);
+    }
+    assert(MessageQueue_size(q) == 1);
+
+    // shrinking: halves after 4 dequeues in a row under 1/4 full, trim goes straight to fit
+    MessageQueue_setShrinkAfter(q, 4);
+    for (int i = 0; i < 200; ++i) {
+        char buf[32]; snprintf(buf, sizeof(buf), "b%d", i);
+        MessageQueue_enqueue(q, Message_new(buf));
+    }
+    assert(MessageQueue_capacity(q) == 256);
+    for (int i = 0; i < 190; ++i) Message_delete(MessageQueue_dequeue(q));
+    assert(MessageQueue_capacity(q) < 256);
+    MessageQueue_trim(q);
+    assert(MessageQueue_capacity(q) == DEFAULT_QUEUE_CAPACITY && MessageQueue_size(q) == 11);
+    Message* first = MessageQueue_dequeue(q); // FIFO order survived the moves ("w16" went first)
+    assert(strcmp(Message_get(first), "b189") == 0);
+    Message_delete(first);
+    MessageQueue_delete(q); // frees the ones left behind
+}
+
+static void test_Batch(void) {
+    MessageQueue* q = MessageQueue_new();
+    MessageQueue_enqueue(q, Message_new("x"));
+    Message_delete(MessageQueue_dequeue(q)); // head off slot 0 so the batch wraps
+    Message* in[40];
+    for (int i = 0; i < 40; ++i) {
+        char buf[32]; snprintf(buf, sizeof(buf), "b%d", i);
+        in[i] = Message_new(buf);
+    }
+    MessageQueue_enqueue_n(q, in, 40);
+    assert(MessageQueue_size(q) == 40 && MessageQueue_capacity(q) == 64);
+    Message* out[64];
+    int n = MessageQueue_dequeue_n(q, out, 64);
+    assert(n == 40);
+    for (int i = 0; i < n; ++i) {
+        char expect[32]; snprintf(expect, sizeof(expect), "b%d", i);
+        assert(strcmp(Message_get(out[i]), expect) == 0);
+        Message_delete(out[i]);
+    }
     MessageQueue_delete(q);
+
+    // priority order holds across levels within one batch
+    MessagePriorityQueue* pq = MPQ_new();
+    Message* lows[] = {Message_new("L1"), Message_new("L2")};
+    Message* highs[] = {Message_new("H1"), Message_new("H2")};
+    MPQ_enqueue_n(pq, lows, 2, PRIORITY_LOW);
+    MPQ_enqueue_n(pq, highs, 2, PRIORITY_HIGHEST);
+    MPQ_enqueue(pq, Message_new("Hi1"), PRIORITY_HIGH);
+    n = MPQ_dequeue_n(pq, out, 4);
+    const char* order[] = {"H1", "H2", "Hi1", "L1"};
+    assert(n == 4 && MPQ_sizeAll(pq) == 1);
+    for (int i = 0; i < n; ++i) {
+        assert(strcmp(Message_get(out[i]), order[i]) == 0);
+        Message_delete(out[i]);
+    }
+    MPQ_delete(pq); // frees "L2"
+}
+
+static void test_Reserve(void) {
+    MessagePriorityQueue* pq = MPQ_new();
+    MPQ_reserve(pq, PRIORITY_HIGHEST, 1000);
+    MPQ_reserve(pq, PRIORITY_LOW, 100);
+    MPQ_setShrinkAfter(pq, 1);
+    Message* pool[1000];
+    for (int i = 0; i < 1000; ++i) pool[i] = Message_new("r");
+    int cap = MessageQueue_capacity(pq->queues[PRIORITY_HIGHEST]);
+#ifdef MPQ_TRACK_ALLOCS
+    long before = heapAllocations;
+#endif
+    // steady state: fill and drain within the reservation, twice, shrink policy armed
+    for (int round = 0; round < 2; ++round) {
+        MPQ_enqueue_n(pq, pool, 1000, PRIORITY_HIGHEST);
+        for (int i = 0; i < 100; ++i) MPQ_enqueue(pq, MPQ_dequeue(pq), PRIORITY_LOW);
+        Message* out[1000];
+        int n = MPQ_dequeue_n(pq, out, 1000);
+        assert(n == 1000);
+    }
+#ifdef MPQ_TRACK_ALLOCS
+    assert(heapAllocations == before); // no malloc/realloc at all, not just none for queues
+#endif
+    assert(MessageQueue_capacity(pq->queues[PRIORITY_HIGHEST]) == cap);
+    MPQ_trim(pq); // the reservation is also the trim floor
+    assert(MessageQueue_capacity(pq->queues[PRIORITY_HIGHEST]) == cap);
+    for (int i = 0; i < 1000; ++i) Message_delete(pool[i]);
+    MPQ_delete(pq);
+}
+
+static void test_SegmentedMessageQueue(void) {
+    SegmentedMessageQueue* q = SegmentedMessageQueue_new();
+    int n = SEGMENT_SLOTS * 10 + 7;
+    for (int i = 0; i < n; ++i) {
+        char buf[32]; snprintf(buf, sizeof(buf), "s%d", i);
+        SegmentedMessageQueue_enqueue(q, Message_new(buf));
+    }
+    assert(SegmentedMessageQueue_size(q) == n && SegmentedMessageQueue_segments(q) == 11);
+    for (int i = 0; i < n - 3; ++i) {
+        char expect[32]; snprintf(expect, sizeof(expect), "s%d", i);
+        Message* m = SegmentedMessageQueue_dequeue(q);
+        assert(m && strcmp(Message_get(m), expect) == 0);
+        Message_delete(m);
+    }
+    // drained segments were handed back; at most SEGMENT_SPARE_LIMIT are kept around
+    assert(SegmentedMessageQueue_segments(q) == 1 && q->spareCount <= SEGMENT_SPARE_LIMIT);
+    // refilling reuses spares before calling malloc again
+    for (int i = 0; i < SEGMENT_SLOTS; ++i) SegmentedMessageQueue_enqueue(q, Message_new("r"));
+    assert(SegmentedMessageQueue_segments(q) == 2 && q->spareCount == SEGMENT_SPARE_LIMIT - 1);
+    SegmentedMessageQueue_delete(q); // frees what is left
+}
+
+static void test_IntrusiveMessageQueue(void) {
+    IntrusiveMessageQueue a, b;
+    IntrusiveMessageQueue_init(&a);
+    IntrusiveMessageQueue_init(&b);
+    for (int i = 0; i < 5; ++i) {
+        char buf[32]; snprintf(buf, sizeof(buf), "i%d", i);
+        IntrusiveMessageQueue_enqueue(&a, Message_new(buf));
+    }
+    // move the first two to another list without copying them
+    for (int i = 0; i < 2; ++i) IntrusiveMessageQueue_enqueue(&b, IntrusiveMessageQueue_dequeue(&a));
+    assert(IntrusiveMessageQueue_size(&a) == 3 && IntrusiveMessageQueue_size(&b) == 2);
+    const char* order[] = {"i2", "i3", "i0"};
+    for (int i = 0; i < 3; ++i) {
+        Message* m = IntrusiveMessageQueue_dequeue(i < 2 ? &a : &b);
+        assert(m && strcmp(Message_get(m), order[i]) == 0);
+        Message_delete(m);
+    }
+    IntrusiveMessageQueue_clear(&a);
+    IntrusiveMessageQueue_clear(&b); // frees i4 and i1
+    assert(IntrusiveMessageQueue_dequeue(&b) == NULL);
 }
 
 static void test_MessagePriorityQueue(void) {
@@ -189,15 +761,34 @@ static void test_MessagePriorityQueue(void) {
         assert(strcmp(Message_get(m), order[i]) == 0);
         Message_delete(m);
     }
-    assert(MPQ_dequeue(pq) == NULL);
+    assert(MPQ_dequeue(pq) == NULL && MPQ_isEmpty(pq));
+
+    // the ready mask follows levels emptying and refilling
+    MPQ_enqueue(pq, Message_new("Lo1"), PRIORITY_LOWEST);
+    MPQ_enqueue(pq, Message_new("Hi2"), PRIORITY_HIGH);
+    Message* m = MPQ_dequeue(pq);
+    assert(strcmp(Message_get(m), "Hi2") == 0 && !MPQ_isEmpty(pq));
+    Message_delete(m);
+    m = MPQ_dequeue(pq);
+    assert(strcmp(Message_get(m), "Lo1") == 0 && MPQ_isEmpty(pq));
+    Message_delete(m);
     MPQ_delete(pq);
 }
 
 int main(void) {
     test_Message();
+#ifndef __STDC_NO_THREADS__
+    test_MessagePoolThreadExit();
+#endif
     test_MessageQueue();
+    test_SegmentedMessageQueue();
+    test_IntrusiveMessageQueue();
     test_MessagePriorityQueue();
+    test_Batch();
+    test_Reserve();
+    Message_releasePool();
     puts("All C tests passed.");
     return 0;
     //gcc -std=c11 -O2 -Wall -Wextra -o mpq mpq.c
+    //gcc -std=c11 -O2 -DMPQ_TRACK_ALLOCS -o mpq mpq.c   (also checks allocation counts)
 }
@@ -1,72 +1,1657 @@
 // mpq.cpp
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// ===== Allocation counting (-DMPQ_TRACK_ALLOCS) =====
+// replaces the global allocation functions, so heapAllocations counts every operator new the
+// program makes: queue buffers, node vectors, bucket pages, messages. tests read it around a
+// steady-state loop to check that the loop never reaches the allocator.
+#ifdef MPQ_TRACK_ALLOCS
+namespace CSE_OOP {
+inline std::atomic<std::size_t> heapAllocations{0};
+}
+// all out of line: once inlined, GCC sees malloc() or free() meet a pointer from operator new or
+// delete and reports a mismatch (-Wmismatched-new-delete) at the caller's delete
+[[gnu::noinline]] void* operator new(std::size_t n) {
+    CSE_OOP::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void* operator new(std::size_t n, std::align_val_t al) {
+    CSE_OOP::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = static_cast<std::size_t>(al);
+    if (void* p = std::aligned_alloc(a, (std::max<std::size_t>(n, 1) + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+
 namespace CSE_OOP {
 
 // ===== Message =====
 // optional C-string message with getMessage(); we’ll store as std::string safely.
+// length-aware constructors and view() are binary-safe (embedded '\0' allowed) and never call strlen.
+// prev/next are intrusive links that belong to the IntrusiveMessageQueue (or, next alone, the
+// IntrusiveMpscMessageQueue) holding the message.
 class Message {
     std::string msgstr;
+    Message* prev = nullptr;
+    Message* next = nullptr;
+    friend class IntrusiveMessageQueue;
+    friend class IntrusiveMpscMessageQueue;
 public:
     explicit Message(const char* s = nullptr) : msgstr(s ? s : "") {}
+    Message(const char* s, std::size_t n) : msgstr(s ? std::string(s, n) : std::string()) { assert(s || n == 0); }
+    explicit Message(std::string_view s) : msgstr(s) {}
+    explicit Message(std::string&& s) noexcept : msgstr(std::move(s)) {} // takes the buffer, no copy
     const char* getMessage() const { return msgstr.empty() ? nullptr : msgstr.c_str(); }
+    std::string_view view() const noexcept { return msgstr; }
+    std::size_t size() const noexcept { return msgstr.size(); }
+
+    // move-only: a message has one owner, and moving it never throws. links are not moved.
+    Message(const Message&) = delete;
+    Message& operator=(const Message&) = delete;
+    Message(Message&& o) noexcept : msgstr(std::move(o.msgstr)) {}
+    Message& operator=(Message&& o) noexcept { msgstr = std::move(o.msgstr); return *this; }
+};
+
+// ===== BasicMessageQueue<T> / MessageQueue (FIFO, dynamic growth) =====
+// power-of-two ring buffer with head/tail indices, so enqueue and dequeue are O(1).
+// grows by doubling and re-linearizes (oldest element back at slot 0). Elements live by
+// value in the slots, so BasicMessageQueue<Message> or a queue of small PODs needs no
+// per-element new/delete. Dispose decides what happens to elements left at destruction.
+// in pointer queues, enqueue's Handle lets cancel() pull an element back out in O(1): the
+// slot becomes a nullptr tombstone that dequeue skips, and the head slot is never one.
+// capacity halves after setShrinkAfter(n) consecutive pops below 1/4 full (off by default),
+// and trim() cuts it to fit right away. reserve(n) preallocates and sets a floor for both,
+// so a warmed-up queue holding at most n elements never calls the allocator.
+
+struct KeepElements { template <class T> void operator()(T&) const noexcept {} };
+struct DeleteElements { template <class T> void operator()(T* p) const noexcept { delete p; } };
+
+template <class T, class Dispose = KeepElements>
+class BasicMessageQueue {
+    static_assert(std::is_nothrow_move_constructible_v<T>, "growth relocates elements by move");
+    static constexpr std::size_t initialCapacity = 16;
+
+    T* buf = nullptr;     // raw storage; slots [head, head + count) mod cap hold live elements
+    std::size_t cap = 0;  // 0 or a power of two
+    std::size_t head = 0; // slot of the oldest element
+    std::size_t tail = 0; // slot the next element goes into
+    std::size_t count = 0;    // occupied slots, tombstones included
+    std::size_t dead = 0;     // tombstones among them
+    std::uint64_t popped = 0; // slots ever removed from the front = sequence number of the head
+
+    void dropFront() {
+        buf[head].~T();
+        head = (head + 1) & (cap - 1);
+        --count;
+        ++popped;
+    }
+    void skipCancelled() {
+        if constexpr (std::is_pointer_v<T>)
+            for (; count && !buf[head]; --dead) dropFront();
+    }
+
+    std::uint32_t shrinkAfter = 0; // pops spent under 1/4 full before halving; 0 = never
+    std::uint32_t lowStreak = 0;
+    std::size_t reserved = 0;      // capacity floor from reserve()
+
+    // moves the occupied slots to a new buffer of ncap (0 or a power of two >= count)
+    void relocate(std::size_t ncap) {
+        T* nb = ncap ? std::allocator<T>().allocate(ncap) : nullptr;
+        for (std::size_t i = 0; i < count; ++i) {
+            T& src = buf[(head + i) & (cap - 1)];
+            ::new (static_cast<void*>(nb + i)) T(std::move(src));
+            src.~T();
+        }
+        if (buf) std::allocator<T>().deallocate(buf, cap);
+        buf = nb;
+        cap = ncap;
+        head = 0;
+        tail = ncap ? count & (ncap - 1) : 0;
+    }
+    void grow() { relocate(cap ? cap * 2 : initialCapacity); }
+    void maybeShrink() {
+        if (!shrinkAfter || cap <= initialCapacity || cap / 2 < reserved) return;
+        if (count >= cap / 4) { lowStreak = 0; return; }
+        if (++lowStreak >= shrinkAfter) {
+            relocate(cap / 2);
+            lowStreak = 0;
+        }
+    }
+public:
+    // names one enqueued element by its sequence number
+    struct Handle { std::uint64_t seq = ~std::uint64_t{0}; };
+
+    BasicMessageQueue() = default;
+    BasicMessageQueue(const BasicMessageQueue&) = delete;
+    BasicMessageQueue& operator=(const BasicMessageQueue&) = delete;
+    ~BasicMessageQueue() {
+        clear();
+        if (buf) std::allocator<T>().deallocate(buf, cap);
+    }
+    // drops every element (disposing of it like the destructor does) and keeps the buffer
+    void clear() {
+        while (count) {
+            Dispose()(buf[head]); // e.g. free undelivered messages
+            dropFront();
+        }
+        head = tail = 0;
+        dead = 0;
+    }
+    // constructs the element in place at the tail
+    template <class... Args>
+    T& emplace(Args&&... args) {
+        if (count == cap) grow();
+        T* slot = ::new (static_cast<void*>(buf + tail)) T(std::forward<Args>(args)...);
+        tail = (tail + 1) & (cap - 1);
+        ++count;
+        return *slot;
+    }
+    Handle enqueue(T v) {
+        if constexpr (std::is_pointer_v<T>) assert(v != nullptr);
+        emplace(std::move(v));
+        return Handle{popped + count - 1};
+    }
+    // moves the oldest element into out; false when empty
+    bool try_pop(T& out) {
+        if (count == 0) return false;
+        out = std::move(buf[head]);
+        dropFront();
+        skipCancelled();
+        maybeShrink();
+        return true;
+    }
+    // appends all of items (moved from) with one capacity check and at most two bulk copies
+    void enqueueBatch(std::span<T> items) {
+        if constexpr (std::is_pointer_v<T>)
+            assert(std::find(items.begin(), items.end(), nullptr) == items.end());
+        std::size_t n = items.size();
+        if (count + n > cap) relocate(std::max(initialCapacity, std::bit_ceil(count + n)));
+        std::size_t first = std::min(n, cap - tail);
+        std::uninitialized_move_n(items.begin(), first, buf + tail);
+        std::uninitialized_move_n(items.begin() + first, n - first, buf);
+        tail = (tail + n) & (cap - 1);
+        count += n;
+    }
+    // moves up to maxN of the oldest elements into out[0..]; returns how many
+    int dequeueBatch(T* out, int maxN) {
+        std::size_t n = std::min(static_cast<std::size_t>(std::max(maxN, 0)), count);
+        if constexpr (std::is_pointer_v<T>) {
+            if (dead) { // tombstones inside: take them one at a time
+                int got = 0;
+                while (got < maxN && try_pop(out[got])) ++got;
+                return got;
+            }
+        }
+        std::size_t first = std::min(n, cap - head);
+        std::move(buf + head, buf + head + first, out);
+        std::move(buf, buf + (n - first), out + first);
+        std::destroy_n(buf + head, first);
+        std::destroy_n(buf, n - first);
+        head = (head + n) & (cap - 1);
+        count -= n;
+        popped += n;
+        if (n) maybeShrink();
+        return static_cast<int>(n);
+    }
+    // takes a still-queued element back out (caller owns it again); nullptr if it already left
+    T cancel(Handle h) requires std::is_pointer_v<T> {
+        if (h.seq < popped || h.seq - popped >= count) return nullptr;
+        T& slot = buf[(head + (h.seq - popped)) & (cap - 1)];
+        T m = slot;
+        if (!m) return nullptr;
+        slot = nullptr;
+        ++dead;
+        skipCancelled();
+        return m;
+    }
+    // pointer queues keep the original interface: nullptr when empty, caller owns the result
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    T& front() { assert(count); return buf[head]; }
+    std::uint64_t headSeq() const { return popped; }
+    std::uint64_t tailSeq() const { return popped + count; } // the next element's sequence number
+    bool empty() const { return count == 0; }
+    int getSize() const { return static_cast<int>(count - dead); }
+    int getCapacity() const { return static_cast<int>(cap); }
+
+    // halve capacity once `pops` consecutive pops have left the queue under 1/4 full; 0 disables
+    void setShrinkAfter(std::uint32_t pops) { shrinkAfter = pops; lowStreak = 0; }
+    // shrink capacity to the smallest power of two that holds the current slots and the
+    // reservation (none when both are zero)
+    void trim() {
+        std::size_t keep = std::max(count, reserved);
+        std::size_t want = keep ? std::bit_ceil(keep) : 0;
+        if (want < cap) relocate(want);
+    }
+    // room for n elements now, and capacity never shrinks below it afterwards
+    void reserve(std::size_t n) {
+        if (n > cap) relocate(std::bit_ceil(n));
+        reserved = n;
+    }
 };
 
-// ===== MessageQueue (FIFO, dynamic growth) =====
-// implement a growable array and own messages on destruction.
-class MessageQueue {
-    std::vector<Message*> q; // owns pointers
+// owns pointers: undelivered messages are deleted with the queue
+using MessageQueue = BasicMessageQueue<Message*, DeleteElements>;
+
+// ===== IntrusiveMessageQueue (FIFO through Message links) =====
+// doubly linked through each Message's own prev/next fields: there is no pointer array to
+// grow, so enqueue, dequeue and remove are a few pointer writes with no allocation, and a
+// message can move to another list without copying. a message is in at most one list.
+class IntrusiveMessageQueue {
+    Message* head = nullptr;
+    Message* tail = nullptr;
+    int count = 0;
 public:
-    MessageQueue() = default;
-    ~MessageQueue() {
-        for (auto* m : q) delete m; // free undelivered
-        q.clear();
+    IntrusiveMessageQueue() = default;
+    IntrusiveMessageQueue(const IntrusiveMessageQueue&) = delete;
+    IntrusiveMessageQueue& operator=(const IntrusiveMessageQueue&) = delete;
+    ~IntrusiveMessageQueue() {
+        while (Message* m = dequeue()) delete m; // free undelivered
     }
     void enqueue(Message* m) {
-        assert(m != nullptr);
-        q.push_back(m);
+        assert(m != nullptr && !m->prev && !m->next && m != head);
+        m->prev = tail;
+        if (tail) tail->next = m;
+        else head = m;
+        tail = m;
+        ++count;
     }
     Message* dequeue() {
-        if (q.empty()) return nullptr;
-        Message* m = q.front();
-        q.erase(q.begin()); // simple for clarity; ring buffer would be O(1)
+        Message* m = head;
+        if (m) remove(m);
         return m; // caller owns
     }
-    int getSize() const { return static_cast<int>(q.size()); }
+    // unlinks m, which must be in this queue, in O(1)
+    void remove(Message* m) {
+        assert(m != nullptr && count > 0);
+        if (m->prev) m->prev->next = m->next;
+        else head = m->next;
+        if (m->next) m->next->prev = m->prev;
+        else tail = m->prev;
+        m->prev = m->next = nullptr;
+        --count;
+    }
+    bool empty() const { return head == nullptr; }
+    int getSize() const { return count; }
 };
 
-// ===== MessagePriorityQueue =====
-// enum Priority contiguous highest..lowest; scan from highest on dequeue.
-class MessagePriorityQueue {
-public:
+// ===== BasicMessagePriorityQueue<T, NPrio> / MessagePriorityQueue =====
+// one FIFO per level, 0 served first; NPrio is a compile-time constant so the level
+// array is inline and the scan loops have a fixed trip count the compiler unrolls.
+// a bitmask of non-empty levels picks the level to serve with one count-trailing-zeros.
+// MessagePriorityQueue keeps the four named levels highest..lowest.
+struct PriorityLevels {
     enum Priority { highest = 0, high, low, lowest };
+};
+
+// how try_pop picks a level. strict always serves the highest ready level (the default);
+// weightedFair is deficit round robin: each ready level in turn gets up to weight messages
+// per round, so a burst on highest cannot starve the lower levels. aging serves a level's
+// head as if it were one level higher once it has waited its level's threshold. all are O(1) per pop.
+enum class DequeuePolicy { strict, weightedFair, aging };
+
+template <class T, int NPrio, class Dispose = KeepElements>
+class BasicMessagePriorityQueue : public PriorityLevels {
+public:
+    using clock = std::chrono::steady_clock;
 private:
-    MessageQueue* queues[lowest - highest + 1];
+    static_assert(NPrio > 0 && NPrio <= 64, "ready mask is one 64-bit word");
+    BasicMessageQueue<T, Dispose> queues[NPrio];
+    std::uint64_t ready = 0; // bit p set <=> queues[p] non-empty
+    DequeuePolicy policy = DequeuePolicy::strict;
+    unsigned weight[NPrio];
+    unsigned deficit[NPrio] = {}; // messages the level may still send this round
+    int current = NPrio - 1;      // level holding the round-robin turn; the first round starts at 0
+    std::uint64_t served[NPrio] = {};
+    // aging: enqueue times keyed by the level queue's sequence numbers, oldest first.
+    // messages queued before aging was switched on carry no stamp; agingSince stands in for theirs.
+    struct Stamp {
+        std::uint64_t seq;
+        clock::time_point time;
+    };
+    BasicMessageQueue<Stamp> stamps[NPrio];
+    clock::duration ageLimit[NPrio];
+    clock::time_point agingSince;
+
+    void stamp(int p, std::uint64_t seq, clock::time_point now) {
+        if (policy == DequeuePolicy::aging) stamps[p].enqueue(Stamp{seq, now});
+    }
+    // the clock is read only when aging needs it
+    clock::time_point agingNow() const { return policy == DequeuePolicy::aging ? clock::now() : clock::time_point{}; }
+    void dropStaleStamps(int p) {
+        Stamp st;
+        while (!stamps[p].empty() && stamps[p].front().seq < queues[p].headSeq()) stamps[p].try_pop(st);
+    }
+    clock::time_point headStamp(int p) {
+        dropStaleStamps(p);
+        return !stamps[p].empty() && stamps[p].front().seq == queues[p].headSeq() ? stamps[p].front().time : agingSince;
+    }
+    void markEmpty(int p) {
+        ready &= ~(std::uint64_t{1} << p);
+        deficit[p] = 0; // an emptied level forfeits the rest of its round
+    }
+
+    // next ready level after current, wrapping around; ready must be non-zero
+    int nextTurn() const {
+        std::uint64_t after = current + 1 < 64 ? ready & (~std::uint64_t{0} << (current + 1)) : 0;
+        return std::countr_zero(after ? after : ready);
+    }
+    int pickLevel(clock::time_point now) {
+        if (policy == DequeuePolicy::strict) return std::countr_zero(ready);
+        if (policy == DequeuePolicy::aging) {
+            // only the next level down can be promoted into a tie with the highest ready one;
+            // it wins if its head is aged and older than the current head
+            int q = std::countr_zero(ready);
+            int r = q + 1;
+            if (r >= NPrio || !((ready >> r) & 1)) return q;
+            clock::time_point waiting = headStamp(r);
+            if (now - waiting < ageLimit[r]) return q;
+            return waiting < headStamp(q) ? r : q;
+        }
+        if (!deficit[current] || !((ready >> current) & 1)) {
+            current = nextTurn();
+            deficit[current] = weight[current];
+        }
+        --deficit[current];
+        return current;
+    }
 public:
-    MessagePriorityQueue() {
-        for (int p = highest; p <= lowest; ++p) queues[p] = new MessageQueue();
+    static constexpr int levels = NPrio;
+    // names one enqueued message: its level and its sequence number within that level
+    struct Handle {
+        int level = -1;
+        std::uint64_t seq = 0;
+    };
+
+    BasicMessagePriorityQueue() {
+        std::fill(weight, weight + NPrio, 1u);
+        std::fill(ageLimit, ageLimit + NPrio, clock::duration::max());
+    }
+
+    // the overloads taking `now` use it in place of clock::now() for aging's stamps and ages
+    void setDequeuePolicy(DequeuePolicy dp, clock::time_point now) {
+        if (policy == DequeuePolicy::aging && dp != DequeuePolicy::aging)
+            for (auto& st : stamps) st.clear();
+        if (policy != DequeuePolicy::aging && dp == DequeuePolicy::aging) agingSince = now;
+        policy = dp;
+    }
+    void setDequeuePolicy(DequeuePolicy dp) { setDequeuePolicy(dp, clock::now()); }
+    DequeuePolicy getDequeuePolicy() const { return policy; }
+    // messages level p may send per round under weightedFair
+    void setWeight(int p, unsigned w) {
+        assert(p >= 0 && p < NPrio && w > 0);
+        weight[p] = w;
+    }
+    void setWeights(const unsigned (&w)[NPrio]) {
+        for (int p = 0; p < NPrio; ++p) setWeight(p, w[p]);
     }
-    ~MessagePriorityQueue() {
-        for (int p = highest; p <= lowest; ++p) { delete queues[p]; queues[p] = nullptr; }
+    // under aging, a level-p head that has waited at least this long competes with level p-1
+    void setAgingThreshold(int p, clock::duration limit) {
+        assert(p >= 0 && p < NPrio);
+        ageLimit[p] = limit;
     }
-    void enqueue(Message* m, Priority p) {
-        assert(m != nullptr);
-        queues[p]->enqueue(m);
+
+    Handle enqueue(T v, int p, clock::time_point now) {
+        assert(p >= 0 && p < NPrio);
+        std::uint64_t seq = queues[p].enqueue(std::move(v)).seq;
+        stamp(p, seq, now);
+        ready |= std::uint64_t{1} << p;
+        return Handle{p, seq};
+    }
+    Handle enqueue(T v, int p) { return enqueue(std::move(v), p, agingNow()); }
+    template <class... Args>
+    T& emplace(int p, Args&&... args) {
+        assert(p >= 0 && p < NPrio);
+        T& v = queues[p].emplace(std::forward<Args>(args)...);
+        stamp(p, queues[p].tailSeq() - 1, agingNow());
+        ready |= std::uint64_t{1} << p;
+        return v;
+    }
+    bool try_pop(T& out, clock::time_point now) {
+        if (!ready) return false;
+        int p = pickLevel(now);
+        queues[p].try_pop(out);
+        ++served[p];
+        if (policy == DequeuePolicy::aging) dropStaleStamps(p);
+        if (queues[p].empty()) markEmpty(p);
+        return true;
+    }
+    bool try_pop(T& out) { return ready && try_pop(out, agingNow()); }
+    // appends items (moved from) to level p as one bulk copy
+    void enqueueBatch(std::span<T> items, int p) {
+        assert(p >= 0 && p < NPrio);
+        if (items.empty()) return;
+        std::uint64_t seq = queues[p].tailSeq();
+        queues[p].enqueueBatch(items);
+        if (policy == DequeuePolicy::aging) { // one clock read for the whole batch
+            clock::time_point now = clock::now();
+            for (std::size_t i = 0; i < items.size(); ++i) stamps[p].enqueue(Stamp{seq + i, now});
+        }
+        ready |= std::uint64_t{1} << p;
+    }
+    // moves up to maxN messages into out[0..] in the order try_pop would return them
+    int dequeueBatch(T* out, int maxN) {
+        int got = 0;
+        if (policy != DequeuePolicy::strict) { // fair and aging pick per message
+            while (got < maxN && try_pop(out[got])) ++got;
+            return got;
+        }
+        while (got < maxN && ready) {
+            int p = std::countr_zero(ready);
+            int n = queues[p].dequeueBatch(out + got, maxN - got);
+            served[p] += n;
+            got += n;
+            if (queues[p].empty()) markEmpty(p);
+        }
+        return got;
+    }
+    // takes a still-queued message back out (caller owns it again); nullptr if it already left
+    T cancel(Handle h) requires std::is_pointer_v<T> {
+        if (h.level < 0) return nullptr;
+        T m = queues[h.level].cancel(typename BasicMessageQueue<T, Dispose>::Handle{h.seq});
+        if (m && queues[h.level].empty()) markEmpty(h.level);
+        return m;
+    }
+    // moves a still-queued message to the back of level p; the old handle stops working
+    Handle changePriority(Handle h, int p) requires std::is_pointer_v<T> {
+        T m = cancel(h);
+        return m ? enqueue(m, p) : Handle{};
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    T dequeue(clock::time_point now) requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m, now);
+        return m;
+    }
+    bool empty() const { return ready == 0; }
+    int getSize(int p) const { assert(p >= 0 && p < NPrio); return queues[p].getSize(); }
+    int getSize() const {
+        int n = 0; for (int p = 0; p < NPrio; ++p) n += queues[p].getSize(); return n;
+    }
+    // messages dequeued from level p so far
+    std::uint64_t getServed(int p) const { assert(p >= 0 && p < NPrio); return served[p]; }
+
+    // preallocates level p for n messages (and its aging stamps when aging is on)
+    void reserve(int p, std::size_t n) {
+        assert(p >= 0 && p < NPrio);
+        queues[p].reserve(n);
+        if (policy == DequeuePolicy::aging) stamps[p].reserve(n);
+    }
+    // shrink policy and trim() for every level (see BasicMessageQueue)
+    void setShrinkAfter(std::uint32_t pops) {
+        for (int p = 0; p < NPrio; ++p) { queues[p].setShrinkAfter(pops); stamps[p].setShrinkAfter(pops); }
+    }
+    void trim() {
+        for (int p = 0; p < NPrio; ++p) { queues[p].trim(); stamps[p].trim(); }
+    }
+};
+
+using MessagePriorityQueue = BasicMessagePriorityQueue<Message*, PriorityLevels::lowest - PriorityLevels::highest + 1, DeleteElements>;
+
+// ===== BasicIntrusiveMessagePriorityQueue<NPrio> / IntrusiveMessagePriorityQueue =====
+// the same levels and ready mask over IntrusiveMessageQueues: strict priority, no allocation
+// on any path, and changePriority relinks a message into another level without copying.
+template <int NPrio>
+class BasicIntrusiveMessagePriorityQueue : public PriorityLevels {
+    static_assert(NPrio > 0 && NPrio <= 64, "ready mask is one 64-bit word");
+    IntrusiveMessageQueue queues[NPrio];
+    std::uint64_t ready = 0;
+public:
+    static constexpr int levels = NPrio;
+
+    void enqueue(Message* m, int p) {
+        assert(p >= 0 && p < NPrio);
+        queues[p].enqueue(m);
+        ready |= std::uint64_t{1} << p;
     }
     Message* dequeue() {
-        for (int p = highest; p <= lowest; ++p) {
-            if (auto* m = queues[p]->dequeue()) return m;
+        if (!ready) return nullptr;
+        int p = std::countr_zero(ready);
+        Message* m = queues[p].dequeue();
+        if (queues[p].empty()) ready &= ready - 1;
+        return m;
+    }
+    // unlinks m from level p (where it must be queued); the caller owns it again
+    void remove(Message* m, int p) {
+        assert(p >= 0 && p < NPrio);
+        queues[p].remove(m);
+        if (queues[p].empty()) ready &= ~(std::uint64_t{1} << p);
+    }
+    void changePriority(Message* m, int from, int to) {
+        remove(m, from);
+        enqueue(m, to);
+    }
+    bool empty() const { return ready == 0; }
+    int getSize(int p) const { assert(p >= 0 && p < NPrio); return queues[p].getSize(); }
+    int getSize() const {
+        int n = 0; for (int p = 0; p < NPrio; ++p) n += queues[p].getSize(); return n;
+    }
+};
+
+using IntrusiveMessagePriorityQueue = BasicIntrusiveMessagePriorityQueue<PriorityLevels::lowest - PriorityLevels::highest + 1>;
+
+// ===== HierarchicalMessagePriorityQueue<T> (65,536 integer levels) =====
+// three-level summary bitmap over 2^16 FIFO buckets, level 0 served first: a bit in top
+// marks a non-empty mid word, a bit in mid marks a non-empty leaf word, a bit in leaf marks
+// a non-empty bucket. enqueue sets at most three bits and finding the highest ready level
+// is three countr_zero. buckets, and the 64-slot pages that hold them, are created on first use
+// and released as soon as they drain, so memory follows the occupied levels; a few drained
+// buckets and one page are kept as spares so a level that keeps emptying does not reallocate.
+template <class T, class Dispose = KeepElements>
+class HierarchicalMessagePriorityQueue {
+public:
+    static constexpr int levels = 1 << 16;
+private:
+    using Bucket = BasicMessageQueue<T, Dispose>;
+    struct Page { std::unique_ptr<Bucket> slot[64]; };
+    static constexpr int leafWords = levels / 64;   // 1024
+    static constexpr int midWords = leafWords / 64; // 16
+    static constexpr int spareLimit = 4;
+
+    std::uint64_t top = 0;
+    std::uint64_t mid[midWords] = {};
+    std::uint64_t leaf[leafWords] = {};
+    std::unique_ptr<Page> pages[leafWords]; // pages[w] holds buckets w*64 .. w*64+63
+    int count = 0;
+    int buckets = 0;
+    std::unique_ptr<Bucket> spareBuckets[spareLimit];
+    int spares = 0;
+    std::unique_ptr<Page> sparePage;
+
+    Bucket& bucketFor(int p) {
+        std::unique_ptr<Page>& page = pages[p >> 6];
+        if (!page) page = sparePage ? std::move(sparePage) : std::make_unique<Page>();
+        std::unique_ptr<Bucket>& b = page->slot[p & 63];
+        if (!b) {
+            b = spares ? std::move(spareBuckets[--spares]) : std::make_unique<Bucket>();
+            ++buckets;
         }
-        return nullptr;
+        return *b;
+    }
+    // returns the drained bucket of level p, and its page once the page holds no other
+    void release(int p) {
+        std::unique_ptr<Page>& page = pages[p >> 6];
+        std::unique_ptr<Bucket>& b = page->slot[p & 63];
+        if (spares < spareLimit) spareBuckets[spares++] = std::move(b);
+        else b.reset();
+        --buckets;
+        if (leaf[p >> 6]) return;
+        if (!sparePage) sparePage = std::move(page);
+        else page.reset();
+    }
+    void markReady(int p) {
+        int w = p >> 6;
+        leaf[w] |= std::uint64_t{1} << (p & 63);
+        mid[w >> 6] |= std::uint64_t{1} << (w & 63);
+        top |= std::uint64_t{1} << (w >> 6);
+    }
+public:
+    HierarchicalMessagePriorityQueue() = default;
+    HierarchicalMessagePriorityQueue(const HierarchicalMessagePriorityQueue&) = delete;
+    HierarchicalMessagePriorityQueue& operator=(const HierarchicalMessagePriorityQueue&) = delete;
+
+    void enqueue(T v, int p) {
+        assert(p >= 0 && p < levels);
+        bucketFor(p).enqueue(std::move(v));
+        markReady(p);
+        ++count;
+    }
+    template <class... Args>
+    T& emplace(int p, Args&&... args) {
+        assert(p >= 0 && p < levels);
+        T& v = bucketFor(p).emplace(std::forward<Args>(args)...);
+        markReady(p);
+        ++count;
+        return v;
+    }
+    // highest ready level (smallest number), or -1 when empty
+    int topLevel() const {
+        if (!top) return -1;
+        int i = std::countr_zero(top);
+        int w = i * 64 + std::countr_zero(mid[i]);
+        return w * 64 + std::countr_zero(leaf[w]);
+    }
+    bool try_pop(T& out) {
+        int p = topLevel();
+        if (p < 0) return false;
+        Bucket& b = *pages[p >> 6]->slot[p & 63];
+        b.try_pop(out);
+        --count;
+        if (b.empty()) {
+            int w = p >> 6;
+            if (!(leaf[w] &= ~(std::uint64_t{1} << (p & 63))) &&
+                !(mid[w >> 6] &= ~(std::uint64_t{1} << (w & 63))))
+                top &= ~(std::uint64_t{1} << (w >> 6));
+            release(p);
+        }
+        return true;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    bool empty() const { return top == 0; }
+    int getSize(int p) const {
+        assert(p >= 0 && p < levels);
+        const std::unique_ptr<Page>& page = pages[p >> 6];
+        return page && page->slot[p & 63] ? page->slot[p & 63]->getSize() : 0;
+    }
+    int getSize() const { return count; }
+    int getBucketCount() const { return buckets; } // buckets holding messages (spares not counted)
+    // frees the spares and trims the buckets in use
+    void trim() {
+        for (auto& b : spareBuckets) b.reset();
+        spares = 0;
+        sparePage.reset();
+        for (int w = 0; w < leafWords; ++w)
+            if (pages[w])
+                for (std::unique_ptr<Bucket>& b : pages[w]->slot)
+                    if (b) b->trim();
+    }
+};
+
+// ===== HeapMessagePriorityQueue<T, D> (arbitrary 64-bit keys) =====
+// implicit D-ary min-heap ordered by (key, sequence number), smallest key served first.
+// the sequence number breaks ties, so equal keys leave in insertion order like the FIFO
+// levels above. with D = 4 a node's children are adjacent and the tree is half as deep as
+// a binary heap. constructing from a range heapifies bottom-up in O(n).
+template <class T, int D = 4, class Dispose = KeepElements>
+class HeapMessagePriorityQueue {
+    static_assert(D >= 2, "heap arity");
+    struct Entry {
+        std::uint64_t key;
+        std::uint64_t seq;
+        T value;
+    };
+    std::vector<Entry> heap;
+    std::uint64_t nextSeq = 0;
+
+    static bool before(const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.seq < b.seq;
+    }
+    void siftUp(std::size_t i) {
+        Entry e = std::move(heap[i]);
+        while (i > 0) {
+            std::size_t parent = (i - 1) / D;
+            if (!before(e, heap[parent])) break;
+            heap[i] = std::move(heap[parent]);
+            i = parent;
+        }
+        heap[i] = std::move(e);
+    }
+    void siftDown(std::size_t i) {
+        const std::size_t n = heap.size();
+        Entry e = std::move(heap[i]);
+        for (;;) {
+            std::size_t first = i * D + 1;
+            if (first >= n) break;
+            std::size_t best = first, last = std::min(first + D, n);
+            for (std::size_t c = first + 1; c < last; ++c)
+                if (before(heap[c], heap[best])) best = c;
+            if (!before(heap[best], e)) break;
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        heap[i] = std::move(e);
+    }
+public:
+    HeapMessagePriorityQueue() = default;
+    // bulk construction from (key, value) pairs; ties keep the range's order
+    template <class InputIt>
+    HeapMessagePriorityQueue(InputIt first, InputIt last) {
+        for (; first != last; ++first) heap.push_back(Entry{first->first, nextSeq++, std::move(first->second)});
+        if (heap.size() > 1)
+            for (std::size_t i = (heap.size() - 2) / D + 1; i-- > 0;) siftDown(i);
     }
-    int getSize(Priority p) const { return queues[p]->getSize(); }
+    HeapMessagePriorityQueue(const HeapMessagePriorityQueue&) = delete;
+    HeapMessagePriorityQueue& operator=(const HeapMessagePriorityQueue&) = delete;
+    ~HeapMessagePriorityQueue() {
+        for (Entry& e : heap) Dispose()(e.value);
+    }
+
+    void enqueue(T v, std::uint64_t key) {
+        if constexpr (std::is_pointer_v<T>) assert(v != nullptr);
+        heap.push_back(Entry{key, nextSeq++, std::move(v)});
+        siftUp(heap.size() - 1);
+    }
+    bool try_pop(T& out) {
+        if (heap.empty()) return false;
+        out = std::move(heap.front().value);
+        if (heap.size() > 1) {
+            heap.front() = std::move(heap.back());
+            heap.pop_back();
+            siftDown(0);
+        } else {
+            heap.pop_back();
+        }
+        return true;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    std::uint64_t topKey() const { assert(!heap.empty()); return heap.front().key; }
+    void reserve(std::size_t n) { heap.reserve(n); }
+    bool empty() const { return heap.empty(); }
+    int getSize() const { return static_cast<int>(heap.size()); }
+};
+
+// ===== RadixMessagePriorityQueue<T> (monotone 64-bit keys) =====
+// radix heap for keys that never go below the last extracted key (timestamps, deadlines).
+// entries equal to last wait in a FIFO; bucket b holds keys whose highest bit differing from
+// last is bit b-1. a bucket is only rescanned when the FIFO runs dry, and each rescan moves
+// every entry to a strictly lower bucket, so operations are amortized O(log C) where C is
+// the key range. equal keys still leave in insertion order.
+template <class T, class Dispose = KeepElements>
+class RadixMessagePriorityQueue {
+    struct Entry {
+        std::uint64_t key;
+        std::uint64_t seq;
+        T value;
+    };
+    BasicMessageQueue<T, Dispose> current; // key == last, in arrival order
+    std::vector<Entry> buckets[65];         // [0] unused
+    std::uint64_t last = 0;                 // last extracted key; lower bound for enqueue
+    std::uint64_t nextSeq = 0;
+    int count = 0;
+
+    int bucketOf(std::uint64_t key) const { return 64 - std::countl_zero(key ^ last); }
+
+    // current is empty: advance last to the smallest key and spread its bucket lower down
+    void refill() {
+        int b = 1;
+        while (buckets[b].empty()) ++b;
+        std::vector<Entry>& from = buckets[b];
+        last = std::min_element(from.begin(), from.end(),
+                                [](const Entry& x, const Entry& y) { return x.key < y.key; })->key;
+        // every entry with the new minimum key sits in this one bucket; release them by arrival
+        std::vector<Entry> due;
+        for (Entry& e : from) {
+            if (e.key == last) due.push_back(std::move(e));
+            else buckets[bucketOf(e.key)].push_back(std::move(e));
+        }
+        from.clear();
+        std::sort(due.begin(), due.end(), [](const Entry& x, const Entry& y) { return x.seq < y.seq; });
+        for (Entry& e : due) current.enqueue(std::move(e.value));
+    }
+public:
+    RadixMessagePriorityQueue() = default;
+    RadixMessagePriorityQueue(const RadixMessagePriorityQueue&) = delete;
+    RadixMessagePriorityQueue& operator=(const RadixMessagePriorityQueue&) = delete;
+    ~RadixMessagePriorityQueue() {
+        for (auto& b : buckets)
+            for (Entry& e : b) Dispose()(e.value);
+    }
+
+    void enqueue(T v, std::uint64_t key) {
+        assert(key >= last && "radix heap keys must not precede the last extracted key");
+        if (key == last) current.enqueue(std::move(v));
+        else buckets[bucketOf(key)].push_back(Entry{key, nextSeq++, std::move(v)});
+        ++count;
+    }
+    bool try_pop(T& out) {
+        if (count == 0) return false;
+        if (current.empty()) refill();
+        current.try_pop(out);
+        --count;
+        return true;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    std::uint64_t lastKey() const { return last; }
+    bool empty() const { return count == 0; }
+    int getSize() const { return count; }
+};
+
+// ===== CalendarMessagePriorityQueue<T> (discrete-event times) =====
+// Brown's calendar queue: event times hash into a "year" of nbuckets "days" of width w,
+// each day a list sorted by (time, sequence number). dequeue walks forward day by day from
+// the last event, so a hold (pop then push a bit later) is O(1) expected once w matches the
+// event spacing. the day count doubles/halves with the size and w is re-estimated from the
+// spacing of the earliest events at each resize. equal times leave in insertion order.
+template <class T, class Dispose = KeepElements>
+class CalendarMessagePriorityQueue {
+    static constexpr std::uint32_t npos = ~std::uint32_t{0};
+    static constexpr std::size_t minBuckets = 2;
+    struct Node {
+        double time;
+        std::uint64_t seq;
+        T value;
+        std::uint32_t next;
+    };
+    std::vector<Node> nodes;
+    std::uint32_t freeList = npos;
+    std::vector<std::uint32_t> buckets = std::vector<std::uint32_t>(minBuckets, npos);
+    double width = 1.0;
+    std::size_t lastBucket = 0;
+    double bucketTop = 1.0;  // end of the current day of lastBucket
+    double lastTime = 0.0;
+    std::uint64_t nextSeq = 0;
+    int count = 0;
+
+    static bool before(const Node& a, const Node& b) { return a.time != b.time ? a.time < b.time : a.seq < b.seq; }
+    std::size_t bucketOf(double t) const {
+        return static_cast<std::size_t>(static_cast<std::int64_t>(std::floor(t / width))) & (buckets.size() - 1);
+    }
+    void link(std::uint32_t i) {
+        std::uint32_t* at = &buckets[bucketOf(nodes[i].time)];
+        while (*at != npos && !before(nodes[i], nodes[*at])) at = &nodes[*at].next;
+        nodes[i].next = *at;
+        *at = i;
+    }
+    void startAt(double t) { // make the day containing t current
+        lastTime = t;
+        lastBucket = bucketOf(t);
+        bucketTop = (std::floor(t / width) + 1) * width;
+    }
+    void resize(std::size_t n) {
+        // gather live nodes, re-estimate the day width from the earliest events, then relink
+        std::vector<std::uint32_t> live;
+        live.reserve(count);
+        for (std::uint32_t head : buckets)
+            for (std::uint32_t i = head; i != npos; i = nodes[i].next) live.push_back(i);
+        auto earlier = [this](std::uint32_t a, std::uint32_t b) { return before(nodes[a], nodes[b]); };
+        std::size_t sample = std::min<std::size_t>(live.size(), 25);
+        std::partial_sort(live.begin(), live.begin() + sample, live.end(), earlier);
+        if (sample > 1) {
+            double total = nodes[live[sample - 1]].time - nodes[live[0]].time;
+            double avg = total / static_cast<double>(sample - 1), trimmed = 0;
+            int kept = 0;
+            for (std::size_t k = 1; k < sample; ++k) { // Brown: ignore gaps over twice the mean
+                double gap = nodes[live[k]].time - nodes[live[k - 1]].time;
+                if (gap <= 2 * avg) { trimmed += gap; ++kept; }
+            }
+            if (kept && trimmed > 0) width = 3 * trimmed / kept;
+        }
+        buckets.assign(n, npos);
+        for (std::uint32_t i : live) link(i);
+        startAt(lastTime);
+    }
+    std::uint32_t popFrom(std::size_t b) {
+        std::uint32_t i = buckets[b];
+        buckets[b] = nodes[i].next;
+        return i;
+    }
+    // index of the earliest node, found by walking days forward from the last event
+    std::size_t findDay() {
+        std::size_t b = lastBucket;
+        double top = bucketTop;
+        for (std::size_t n = 0; n < buckets.size(); ++n) {
+            std::uint32_t i = buckets[b];
+            if (i != npos && nodes[i].time < top) {
+                lastBucket = b;
+                bucketTop = top;
+                return b;
+            }
+            b = (b + 1) & (buckets.size() - 1);
+            top += width;
+        }
+        // a whole year without a hit: jump straight to the earliest head
+        std::uint32_t best = npos;
+        for (std::uint32_t head : buckets)
+            if (head != npos && (best == npos || before(nodes[head], nodes[best]))) best = head;
+        startAt(nodes[best].time);
+        return lastBucket;
+    }
+public:
+    CalendarMessagePriorityQueue() = default;
+    CalendarMessagePriorityQueue(const CalendarMessagePriorityQueue&) = delete;
+    CalendarMessagePriorityQueue& operator=(const CalendarMessagePriorityQueue&) = delete;
+    ~CalendarMessagePriorityQueue() {
+        for (std::uint32_t head : buckets)
+            for (std::uint32_t i = head; i != npos; i = nodes[i].next) Dispose()(nodes[i].value);
+    }
+
+    void enqueue(T v, double time) {
+        if constexpr (std::is_pointer_v<T>) assert(v != nullptr);
+        std::uint32_t i;
+        if (freeList != npos) {
+            i = freeList;
+            freeList = nodes[i].next;
+            nodes[i].time = time;
+            nodes[i].seq = nextSeq++;
+            nodes[i].value = std::move(v);
+        } else {
+            i = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back(Node{time, nextSeq++, std::move(v), npos});
+        }
+        link(i);
+        if (count++ == 0 || time < lastTime) startAt(time);
+        if (static_cast<std::size_t>(count) > 2 * buckets.size()) resize(2 * buckets.size());
+    }
+    bool try_pop(T& out) {
+        if (count == 0) return false;
+        std::uint32_t i = popFrom(findDay());
+        lastTime = nodes[i].time;
+        out = std::move(nodes[i].value);
+        nodes[i].next = freeList;
+        freeList = i;
+        if (--count > 0 && buckets.size() > minBuckets && static_cast<std::size_t>(count) < buckets.size() / 2)
+            resize(buckets.size() / 2);
+        return true;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    double topTime() { assert(count); return nodes[buckets[findDay()]].time; }
+    bool empty() const { return count == 0; }
+    int getSize() const { return count; }
+};
+
+// ===== TimingWheel<T> =====
+// hierarchical timing wheel: depth levels of 64 slots, a slot on level L spans 64^L ticks.
+// a timer sits in one doubly linked slot list, so schedule and cancel are O(1); advancing a
+// tick fires one level-0 slot, and every 64^L ticks one level-L slot cascades down a level.
+// idle stretches are skipped up to the next boundary of the lowest occupied level.
+// timers further out than 64^depth ticks wait in the last top-level slot and are re-placed.
+// slot lists are kept in schedule order, so timers due on the same tick fire first in, first out.
+// nodes live in a pooled vector and are named by (index, generation) handles.
+template <class T>
+class TimingWheel {
+public:
+    static constexpr int slotBits = 6, slots = 1 << slotBits, depth = 4;
+    struct Handle {
+        std::uint32_t index = ~std::uint32_t{0};
+        std::uint32_t generation = 0;
+    };
+private:
+    static constexpr std::uint32_t npos = ~std::uint32_t{0};
+    struct Node {
+        T value;
+        std::uint64_t due;
+        std::uint64_t seq;        // schedule order, for ties
+        std::uint32_t prev, next; // slot list links; prev == npos at the head, next == npos at the tail
+        std::uint32_t generation;
+        int level, slot;          // level == -1 while the node is free
+    };
+    std::vector<Node> nodes;
+    std::uint32_t freeList = npos; // free nodes chained through next
+    std::uint32_t wheel[depth][slots];
+    std::uint32_t wheelTail[depth][slots];
+    int perLevel[depth] = {};
+    std::uint64_t now = 0;
+    std::uint64_t nextSeq = 0;
+    int count = 0;
+
+    void place(std::uint32_t i) {
+        Node& n = nodes[i];
+        std::uint64_t delta = n.due - now, d = n.due;
+        int level = 0;
+        while (level < depth - 1 && delta >= std::uint64_t{1} << (slotBits * (level + 1))) ++level;
+        if (level == depth - 1 && delta >= std::uint64_t{1} << (slotBits * depth))
+            d = now + (std::uint64_t{1} << (slotBits * depth)) - 1; // clamp; re-placed on cascade
+        n.level = level;
+        n.slot = static_cast<int>((d >> (slotBits * level)) & (slots - 1));
+        ++perLevel[level];
+        // append, stepping back past any later-scheduled timers already there: a cascade can
+        // bring an older timer down into a level-0 slot that a newer one reached directly
+        std::uint32_t after = wheelTail[level][n.slot];
+        while (after != npos && nodes[after].seq > n.seq) after = nodes[after].prev;
+        std::uint32_t before = after != npos ? nodes[after].next : wheel[level][n.slot];
+        n.prev = after;
+        n.next = before;
+        if (after != npos) nodes[after].next = i;
+        else wheel[level][n.slot] = i;
+        if (before != npos) nodes[before].prev = i;
+        else wheelTail[level][n.slot] = i;
+    }
+    void unlink(std::uint32_t i) {
+        Node& n = nodes[i];
+        if (n.prev != npos) nodes[n.prev].next = n.next;
+        else wheel[n.level][n.slot] = n.next;
+        if (n.next != npos) nodes[n.next].prev = n.prev;
+        else wheelTail[n.level][n.slot] = n.prev;
+        --perLevel[n.level];
+    }
+    void release(std::uint32_t i) {
+        Node& n = nodes[i];
+        n.level = -1;
+        ++n.generation;
+        n.next = freeList;
+        freeList = i;
+        --count;
+    }
+public:
+    TimingWheel() {
+        for (int level = 0; level < depth; ++level)
+            for (int slot = 0; slot < slots; ++slot) wheel[level][slot] = wheelTail[level][slot] = npos;
+    }
+    std::uint64_t currentTick() const { return now; }
+    int getSize() const { return count; }
+
+    // due must be after currentTick(); earlier deadlines are the caller's to deliver
+    Handle schedule(T v, std::uint64_t due) {
+        assert(due > now);
+        std::uint32_t i;
+        if (freeList != npos) {
+            i = freeList;
+            freeList = nodes[i].next;
+            nodes[i].value = std::move(v);
+        } else {
+            i = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back(Node{std::move(v), 0, 0, npos, npos, 0, -1, 0});
+        }
+        nodes[i].due = due;
+        nodes[i].seq = nextSeq++;
+        place(i);
+        ++count;
+        return Handle{i, nodes[i].generation};
+    }
+    // removes a pending timer and hands its value back; false if it already fired or was cancelled
+    bool cancel(Handle h, T& out) {
+        if (h.index >= nodes.size()) return false;
+        Node& n = nodes[h.index];
+        if (n.level < 0 || n.generation != h.generation) return false;
+        unlink(h.index);
+        out = std::move(n.value);
+        release(h.index);
+        return true;
+    }
+    // moves time forward to tick `to`, calling fire(T&&) for each timer that comes due, in deadline
+    // order and, for equal deadlines, in the order they were scheduled
+    template <class Fire>
+    void advance(std::uint64_t to, Fire&& fire) {
+        while (now < to) {
+            if (count == 0) { now = to; break; }
+            int lowest = 0;
+            while (!perLevel[lowest]) ++lowest;
+            if (lowest > 0) { // nothing can fire before the next level-`lowest` boundary
+                std::uint64_t boundary = ((now >> (slotBits * lowest)) + 1) << (slotBits * lowest);
+                now = std::min(to, boundary) - 1;
+                if (now + 1 < boundary) { now = to; break; }
+            }
+            ++now;
+            // cascade from the top so re-placed timers can fall through several levels this tick
+            for (int level = depth - 1; level > 0; --level) {
+                if (now & ((std::uint64_t{1} << (slotBits * level)) - 1)) continue;
+                int slot = static_cast<int>((now >> (slotBits * level)) & (slots - 1));
+                std::uint32_t i = wheel[level][slot];
+                wheel[level][slot] = wheelTail[level][slot] = npos;
+                while (i != npos) {
+                    std::uint32_t next = nodes[i].next;
+                    --perLevel[level];
+                    place(i);
+                    i = next;
+                }
+            }
+            std::uint32_t i = wheel[0][now & (slots - 1)];
+            wheel[0][now & (slots - 1)] = wheelTail[0][now & (slots - 1)] = npos;
+            while (i != npos) {
+                std::uint32_t next = nodes[i].next;
+                --perLevel[0];
+                fire(std::move(nodes[i].value));
+                release(i);
+                i = next;
+            }
+        }
+    }
+    template <class F>
+    void forEachPending(F&& f) {
+        for (Node& n : nodes)
+            if (n.level >= 0) f(n.value);
+    }
+};
+
+// ===== BasicDelayedMessagePriorityQueue<T, NPrio> / DelayedMessagePriorityQueue =====
+// a priority queue whose messages can be held until a future time: enqueueAt/enqueueAfter park
+// the message in a TimingWheel, and once due it moves into its priority level. pending timers
+// cost nothing per dequeue until one comes due; cancel() hands a pending message back.
+template <class T, int NPrio, class Dispose = KeepElements>
+class BasicDelayedMessagePriorityQueue : public PriorityLevels {
+public:
+    using clock = std::chrono::steady_clock;
+private:
+    struct Pending {
+        T value;
+        int level;
+    };
+    BasicMessagePriorityQueue<T, NPrio, Dispose> ready;
+    TimingWheel<Pending> timers;
+    clock::time_point origin;
+    clock::duration tick;
+
+    std::uint64_t tickOf(clock::time_point t) const { // rounded up so nothing is released early
+        if (t <= origin) return 0;
+        return static_cast<std::uint64_t>((t - origin + tick - clock::duration(1)) / tick);
+    }
+public:
+    using Handle = typename TimingWheel<Pending>::Handle;
+    static constexpr int levels = NPrio;
+
+    explicit BasicDelayedMessagePriorityQueue(clock::duration tick = std::chrono::milliseconds(1),
+                                              clock::time_point origin = clock::now())
+        : origin(origin), tick(tick) { assert(tick.count() > 0); }
+    BasicDelayedMessagePriorityQueue(const BasicDelayedMessagePriorityQueue&) = delete;
+    BasicDelayedMessagePriorityQueue& operator=(const BasicDelayedMessagePriorityQueue&) = delete;
+    ~BasicDelayedMessagePriorityQueue() {
+        timers.forEachPending([](Pending& pm) { Dispose()(pm.value); });
+    }
+
+    void enqueue(T v, int p) { ready.enqueue(std::move(v), p); }
+    // held until `when`; a time that is already due goes straight to level p
+    Handle enqueueAt(T v, int p, clock::time_point when) {
+        assert(p >= 0 && p < NPrio);
+        std::uint64_t due = tickOf(when);
+        if (due <= timers.currentTick()) {
+            ready.enqueue(std::move(v), p);
+            return Handle{};
+        }
+        return timers.schedule(Pending{std::move(v), p}, due);
+    }
+    Handle enqueueAfter(T v, int p, clock::duration delay) { return enqueueAt(std::move(v), p, clock::now() + delay); }
+    // takes a still-pending message back (the caller owns it again); false once it is due
+    bool cancel(Handle h, T& out) {
+        Pending pm{};
+        if (!timers.cancel(h, pm)) return false;
+        out = std::move(pm.value);
+        return true;
+    }
+    // releases every message due at or before `now` into its priority level
+    void poll(clock::time_point now) {
+        timers.advance(tickOf(now), [this](Pending&& pm) { ready.enqueue(std::move(pm.value), pm.level); });
+    }
+    bool try_pop(T& out) {
+        if (timers.getSize()) poll(clock::now());
+        return ready.try_pop(out);
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    int getSize(int p) const { return ready.getSize(p); }
+    int getSize() const { return ready.getSize(); }   // deliverable now
+    int getPendingCount() const { return timers.getSize(); }
+};
+
+using DelayedMessagePriorityQueue = BasicDelayedMessagePriorityQueue<Message*, PriorityLevels::lowest - PriorityLevels::highest + 1, DeleteElements>;
+
+// ===== BasicConcurrentMessagePriorityQueue<T, NPrio> / ConcurrentMessagePriorityQueue =====
+// a BasicMessagePriorityQueue behind one mutex, shared by any number of producer and consumer
+// threads. a consumer that finds it empty sleeps on a condition variable until an enqueue (or
+// close()) wakes it; no polling. the lock covers only the queue operation itself, and producers
+// notify after releasing it, and only when some consumer is actually asleep.
+template <class T, int NPrio, class Dispose = KeepElements>
+class BasicConcurrentMessagePriorityQueue : public PriorityLevels {
+public:
+    using clock = std::chrono::steady_clock;
+private:
+    mutable std::mutex lock;
+    std::condition_variable nonEmpty;
+    BasicMessagePriorityQueue<T, NPrio, Dispose> queue;
+    int sleepers = 0; // consumers blocked in nonEmpty
+    bool closed = false;
+
+    // releases the lock, then wakes one sleeper per new message
+    void wake(std::unique_lock<std::mutex>& held, std::size_t added) {
+        int waiting = sleepers;
+        held.unlock();
+        if (waiting == 1 || (waiting && added == 1)) nonEmpty.notify_one();
+        else if (waiting) nonEmpty.notify_all();
+    }
+    // false if the deadline passed with nothing to take
+    bool waitUntil(std::unique_lock<std::mutex>& held, clock::time_point deadline) {
+        if (!queue.empty() || closed) return true;
+        ++sleepers;
+        bool ok = nonEmpty.wait_until(held, deadline, [this] { return !queue.empty() || closed; });
+        --sleepers;
+        return ok;
+    }
+public:
+    static constexpr int levels = NPrio;
+
+    BasicConcurrentMessagePriorityQueue() = default;
+    BasicConcurrentMessagePriorityQueue(const BasicConcurrentMessagePriorityQueue&) = delete;
+    BasicConcurrentMessagePriorityQueue& operator=(const BasicConcurrentMessagePriorityQueue&) = delete;
+
+    void enqueue(T v, int p) {
+        std::unique_lock<std::mutex> held(lock);
+        queue.enqueue(std::move(v), p);
+        wake(held, 1);
+    }
+    void enqueueBatch(std::span<T> items, int p) {
+        if (items.empty()) return;
+        std::unique_lock<std::mutex> held(lock);
+        queue.enqueueBatch(items, p);
+        wake(held, items.size());
+    }
+    // never blocks; false if nothing is queued
+    bool tryDequeue(T& out) {
+        std::lock_guard<std::mutex> held(lock);
+        return queue.try_pop(out);
+    }
+    // blocks until a message is available; false only once closed and drained
+    bool dequeueWait(T& out) {
+        std::unique_lock<std::mutex> held(lock);
+        if (queue.empty() && !closed) {
+            ++sleepers;
+            nonEmpty.wait(held, [this] { return !queue.empty() || closed; });
+            --sleepers;
+        }
+        return queue.try_pop(out);
+    }
+    // blocks for at most timeout; false if nothing arrived in time
+    bool dequeueFor(clock::duration timeout, T& out) {
+        std::unique_lock<std::mutex> held(lock);
+        return waitUntil(held, clock::now() + timeout) && queue.try_pop(out);
+    }
+    int dequeueBatch(T* out, int maxN) {
+        std::lock_guard<std::mutex> held(lock);
+        return queue.dequeueBatch(out, maxN);
+    }
+    T tryDequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        tryDequeue(m);
+        return m;
+    }
+    T dequeueWait() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        dequeueWait(m);
+        return m;
+    }
+    T dequeueFor(clock::duration timeout) requires std::is_pointer_v<T> {
+        T m = nullptr;
+        dequeueFor(timeout, m);
+        return m;
+    }
+    // wakes every blocked consumer; from now on waits return at once when the queue is empty
+    void close() {
+        {
+            std::lock_guard<std::mutex> held(lock);
+            closed = true;
+        }
+        nonEmpty.notify_all();
+    }
+    bool isClosed() const { std::lock_guard<std::mutex> held(lock); return closed; }
+
+    void setDequeuePolicy(DequeuePolicy dp) { std::lock_guard<std::mutex> held(lock); queue.setDequeuePolicy(dp); }
+    void setWeight(int p, unsigned w) { std::lock_guard<std::mutex> held(lock); queue.setWeight(p, w); }
+    void setAgingThreshold(int p, clock::duration limit) { std::lock_guard<std::mutex> held(lock); queue.setAgingThreshold(p, limit); }
+    void reserve(int p, std::size_t n) { std::lock_guard<std::mutex> held(lock); queue.reserve(p, n); }
+    // sizes are a snapshot; other threads may change them before the caller looks
+    bool empty() const { std::lock_guard<std::mutex> held(lock); return queue.empty(); }
+    int getSize(int p) const { std::lock_guard<std::mutex> held(lock); return queue.getSize(p); }
+    int getSize() const { std::lock_guard<std::mutex> held(lock); return queue.getSize(); }
+};
+
+using ConcurrentMessagePriorityQueue = BasicConcurrentMessagePriorityQueue<Message*, PriorityLevels::lowest - PriorityLevels::highest + 1, DeleteElements>;
+
+// ===== BasicSpscMessageQueue<T> / SpscMessageQueue (one producer thread, one consumer thread) =====
+// bounded lock-free ring for exactly one enqueuing and one dequeuing thread. tail is written only
+// by the producer and head only by the consumer, each on its own cache line and published with
+// release / read with acquire. each side also keeps a private copy of the other side's index and
+// rereads the shared one only when the copy says full (or empty), so in steady state an operation
+// touches no cache line the other thread writes except the slot itself.
+inline constexpr std::size_t cacheLineSize = 64;
+
+template <class T, class Dispose = KeepElements>
+class BasicSpscMessageQueue {
+    static_assert(std::is_nothrow_move_constructible_v<T>, "slots are filled by move");
+    // indices run freely and wrap modulo 2^64; slot = index & mask
+    alignas(cacheLineSize) std::atomic<std::size_t> tail{0}; // producer's line
+    std::size_t headCache = 0;
+    alignas(cacheLineSize) std::atomic<std::size_t> head{0}; // consumer's line
+    std::size_t tailCache = 0;
+    alignas(cacheLineSize) T* buf;                           // read-only after construction
+    std::size_t cap;
+    std::size_t mask;
+public:
+    // capacity is rounded up to a power of two
+    explicit BasicSpscMessageQueue(std::size_t capacity = 1024)
+        : cap(std::bit_ceil(std::max<std::size_t>(capacity, 2))), mask(cap - 1) {
+        buf = std::allocator<T>().allocate(cap);
+    }
+    BasicSpscMessageQueue(const BasicSpscMessageQueue&) = delete;
+    BasicSpscMessageQueue& operator=(const BasicSpscMessageQueue&) = delete;
+    ~BasicSpscMessageQueue() {
+        T v;
+        while (try_pop(v)) Dispose()(v);
+        std::allocator<T>().deallocate(buf, cap);
+    }
+
+    // producer only; false (v untouched) when full
+    bool try_enqueue(T&& v) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == cap) {
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == cap) return false;
+        }
+        ::new (static_cast<void*>(buf + (t & mask))) T(std::move(v));
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_enqueue(const T& v) {
+        T copy(v);
+        return try_enqueue(std::move(copy));
+    }
+    // consumer only; false when empty
+    bool try_pop(T& out) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache) {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache) return false;
+        }
+        T& slot = buf[h & mask];
+        out = std::move(slot);
+        slot.~T();
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    // producer only: copies as many of items as fit with one publish; returns how many
+    std::size_t enqueueBatch(std::span<T> items) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (cap - (t - headCache) < items.size()) headCache = head.load(std::memory_order_acquire);
+        std::size_t n = std::min(items.size(), cap - (t - headCache));
+        for (std::size_t i = 0; i < n; ++i) ::new (static_cast<void*>(buf + ((t + i) & mask))) T(std::move(items[i]));
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+    // consumer only: moves up to maxN elements into out[0..] with one publish
+    int dequeueBatch(T* out, int maxN) {
+        maxN = std::max(maxN, 0);
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (tailCache - h < static_cast<std::size_t>(maxN)) tailCache = tail.load(std::memory_order_acquire);
+        int n = static_cast<int>(std::min(tailCache - h, static_cast<std::size_t>(maxN)));
+        for (int i = 0; i < n; ++i) {
+            T& slot = buf[(h + i) & mask];
+            out[i] = std::move(slot);
+            slot.~T();
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    // exact only when called from one of the two threads with the other idle
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
     int getSize() const {
-        int n = 0; for (int p = highest; p <= lowest; ++p) n += queues[p]->getSize(); return n;
+        return static_cast<int>(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
     }
+    int getCapacity() const { return static_cast<int>(cap); }
+};
+
+using SpscMessageQueue = BasicSpscMessageQueue<Message*, DeleteElements>;
+
+// ===== BasicMpmcMessageQueue<T> / MpmcMessageQueue (many producers, many consumers) =====
+// bounded lock-free FIFO over a ring of cells, each carrying a sequence number (Vyukov's design).
+// cell i is free for the enqueue at position pos when seq == pos, and holds that element for the
+// dequeue at pos when seq == pos + 1; the dequeue then sets seq = pos + cap for the next lap.
+// a producer claims a position with one compare-exchange on enqueuePos, a consumer on dequeuePos,
+// and the two counters sit on separate cache lines, so producers and consumers only meet in cells.
+// SeqCst = true publishes and reads the cell sequence numbers seq_cst rather than release/acquire,
+// so a caller can order them against its own seq_cst operations (BasicLockFreeMessagePriorityQueue).
+template <class T, class Dispose = KeepElements, bool SeqCst = false>
+class BasicMpmcMessageQueue {
+    static_assert(std::is_nothrow_move_constructible_v<T>, "cells are filled by move");
+    static constexpr std::memory_order publish = SeqCst ? std::memory_order_seq_cst : std::memory_order_release;
+    static constexpr std::memory_order observe = SeqCst ? std::memory_order_seq_cst : std::memory_order_acquire;
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        T value;
+    };
+    alignas(cacheLineSize) std::atomic<std::size_t> enqueuePos{0};
+    alignas(cacheLineSize) std::atomic<std::size_t> dequeuePos{0};
+    alignas(cacheLineSize) std::unique_ptr<Cell[]> cells;
+    std::size_t cap;
+    std::size_t mask;
+public:
+    // capacity is rounded up to a power of two
+    explicit BasicMpmcMessageQueue(std::size_t capacity = 1024)
+        : cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+          cap(std::bit_ceil(std::max<std::size_t>(capacity, 2))), mask(cap - 1) {
+        for (std::size_t i = 0; i < cap; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    BasicMpmcMessageQueue(const BasicMpmcMessageQueue&) = delete;
+    BasicMpmcMessageQueue& operator=(const BasicMpmcMessageQueue&) = delete;
+    ~BasicMpmcMessageQueue() {
+        T v;
+        while (try_pop(v)) Dispose()(v);
+    }
+
+    // any thread; false (v untouched) when full
+    bool try_enqueue(T&& v) {
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & mask];
+            std::size_t seq = c.seq.load(observe);
+            auto lag = static_cast<std::ptrdiff_t>(seq - pos);
+            if (lag == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = std::move(v);
+                    c.seq.store(pos + 1, publish);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false; // the cell still holds last lap's element
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    bool try_enqueue(const T& v) {
+        T copy(v);
+        return try_enqueue(std::move(copy));
+    }
+    // any thread; false when empty
+    bool try_pop(T& out) {
+        std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & mask];
+            std::size_t seq = c.seq.load(observe);
+            auto lag = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (lag == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(c.value);
+                    c.seq.store(pos + cap, publish);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false; // not yet written for this lap
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    // like MessageQueue::enqueue it always succeeds: yields while the ring is full
+    void enqueue(T v) {
+        while (!try_enqueue(std::move(v))) std::this_thread::yield();
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    // approximate while other threads are working on the queue
+    int getSize() const {
+        std::size_t d = dequeuePos.load(std::memory_order_acquire);
+        std::size_t e = enqueuePos.load(std::memory_order_acquire);
+        return e > d ? static_cast<int>(e - d) : 0;
+    }
+    bool empty() const { return getSize() == 0; }
+    int getCapacity() const { return static_cast<int>(cap); }
+};
+
+using MpmcMessageQueue = BasicMpmcMessageQueue<Message*, DeleteElements>;
+
+// ===== BasicLockFreeMessagePriorityQueue<T, NPrio> / LockFreeMessagePriorityQueue =====
+// the strict level order of MessagePriorityQueue for many threads without a lock: each level is
+// its own BasicMpmcMessageQueue lane, and an atomic mask marks the lanes that may be non-empty.
+// a consumer reads the mask and pops from its lowest set bit; a producer sets its level's bit
+// only when it is clear, so producers on different levels share no written cache line.
+// a bit may be set over an empty lane (a consumer clears it on the next miss), but never clear
+// over a non-empty one: a consumer that clears a bit looks at the lane once more afterwards.
+// that handshake (producer: publish cell, read mask; consumer: clear bit, read cell) needs one
+// total order, so the lanes publish and read cells seq_cst and so do the mask operations.
+// lanes are bounded; try_enqueue fails when the level is full and enqueue yields until it is not.
+template <class T, int NPrio, class Dispose = KeepElements>
+class BasicLockFreeMessagePriorityQueue : public PriorityLevels {
+    static_assert(NPrio > 0 && NPrio <= 64, "ready mask is one 64-bit word");
+    using Lane = BasicMpmcMessageQueue<T, Dispose, true>;
+    std::unique_ptr<Lane> lanes[NPrio]; // separate allocations keep lanes off each other's lines
+    alignas(cacheLineSize) std::atomic<std::uint64_t> ready{0}; // on a line of its own
+
+    void markReady(int p) {
+        std::uint64_t bit = std::uint64_t{1} << p;
+        if (!(ready.load(std::memory_order_seq_cst) & bit)) ready.fetch_or(bit, std::memory_order_seq_cst);
+    }
+public:
+    static constexpr int levels = NPrio;
+
+    // every level holds up to capacityPerLevel messages (rounded up to a power of two)
+    explicit BasicLockFreeMessagePriorityQueue(std::size_t capacityPerLevel = 1024) {
+        for (auto& lane : lanes) lane = std::make_unique<Lane>(capacityPerLevel);
+    }
+    BasicLockFreeMessagePriorityQueue(const BasicLockFreeMessagePriorityQueue&) = delete;
+    BasicLockFreeMessagePriorityQueue& operator=(const BasicLockFreeMessagePriorityQueue&) = delete;
+
+    // any thread; false (v untouched) when level p is full
+    bool try_enqueue(T&& v, int p) {
+        assert(p >= 0 && p < NPrio);
+        if (!lanes[p]->try_enqueue(std::move(v))) return false;
+        markReady(p);
+        return true;
+    }
+    bool try_enqueue(const T& v, int p) {
+        T copy(v);
+        return try_enqueue(std::move(copy), p);
+    }
+    void enqueue(T v, int p) {
+        while (!try_enqueue(std::move(v), p)) std::this_thread::yield();
+    }
+    // any thread; false when every level is empty
+    bool try_pop(T& out) {
+        std::uint64_t mask = ready.load(std::memory_order_acquire);
+        while (mask) {
+            int p = std::countr_zero(mask);
+            std::uint64_t bit = std::uint64_t{1} << p;
+            if (lanes[p]->try_pop(out)) return true;
+            // looked empty: clear its bit, then look once more in case a producer saw it still set
+            ready.fetch_and(~bit, std::memory_order_seq_cst);
+            if (lanes[p]->try_pop(out)) { // arrived while the bit was being cleared
+                ready.fetch_or(bit, std::memory_order_seq_cst); // there may be more behind it
+                return true;
+            }
+            // go on to the lower levels
+            mask = p + 1 < 64 ? ready.load(std::memory_order_acquire) & (~std::uint64_t{0} << (p + 1)) : 0;
+        }
+        return false;
+    }
+    T dequeue() requires std::is_pointer_v<T> {
+        T m = nullptr;
+        try_pop(m);
+        return m;
+    }
+    // approximate while other threads are working on the queue
+    bool empty() const { return getSize() == 0; }
+    int getSize(int p) const { assert(p >= 0 && p < NPrio); return lanes[p]->getSize(); }
+    int getSize() const {
+        int n = 0; for (int p = 0; p < NPrio; ++p) n += lanes[p]->getSize(); return n;
+    }
+};
+
+using LockFreeMessagePriorityQueue = BasicLockFreeMessagePriorityQueue<Message*, PriorityLevels::lowest - PriorityLevels::highest + 1, DeleteElements>;
+
+// ===== IntrusiveMpscMessageQueue (actor mailbox: many senders, one owner) =====
+// unbounded FIFO linked through each Message's next field (Vyukov's intrusive MPSC list).
+// enqueue is wait-free and allocation-free: one atomic exchange on head plus one release store
+// that links the previous message to the new one. the owner thread dequeues from tail without
+// any read-modify-write except when the list runs dry, where a stub node keeps it non-empty.
+// a sender that has swapped head but not yet linked makes the list look briefly empty: dequeue
+// returns nullptr and the message shows up on a later call.
+class IntrusiveMpscMessageQueue {
+    static_assert(std::atomic_ref<Message*>::required_alignment <= alignof(Message*),
+                  "links are accessed through atomic_ref");
+    alignas(cacheLineSize) std::atomic<Message*> head; // senders' line: newest message
+    alignas(cacheLineSize) Message* tail;              // owner's line: oldest, or the stub
+    Message stub;
+
+    static std::atomic_ref<Message*> link(Message* m) { return std::atomic_ref<Message*>(m->next); }
+    void push(Message* m) {
+        link(m).store(nullptr, std::memory_order_relaxed);
+        Message* prev = head.exchange(m, std::memory_order_acq_rel);
+        link(prev).store(m, std::memory_order_release);
+    }
+public:
+    IntrusiveMpscMessageQueue() : head(&stub), tail(&stub) {}
+    IntrusiveMpscMessageQueue(const IntrusiveMpscMessageQueue&) = delete;
+    IntrusiveMpscMessageQueue& operator=(const IntrusiveMpscMessageQueue&) = delete;
+    ~IntrusiveMpscMessageQueue() {
+        while (Message* m = dequeue()) delete m; // free undelivered
+    }
+
+    // any thread; m must not be in any other list
+    void enqueue(Message* m) {
+        assert(m != nullptr && m != &stub);
+        push(m);
+    }
+    // owner thread only; caller owns the result
+    Message* dequeue() {
+        Message* t = tail;
+        Message* n = link(t).load(std::memory_order_acquire);
+        if (t == &stub) { // skip past the stub
+            if (!n) return nullptr;
+            tail = t = n;
+            n = link(t).load(std::memory_order_acquire);
+        }
+        if (!n) {
+            if (t != head.load(std::memory_order_acquire)) return nullptr; // a sender is mid-link
+            push(&stub); // t is the last message: put the stub behind it so t can leave
+            n = link(t).load(std::memory_order_acquire);
+            if (!n) return nullptr;
+        }
+        tail = n;
+        t->next = nullptr; // no sender touches t again once its next is set
+        return t;
+    }
+    // owner thread only
+    bool empty() { return tail == &stub && !link(&stub).load(std::memory_order_acquire); }
 };
 
 } // namespace CSE_OOP
@@ -79,6 +1664,17 @@ static void test_Message() {
     assert(std::strcmp(a.getMessage(), "hello") == 0);
     Message b(nullptr);
     assert(b.getMessage() == nullptr);
+
+    // binary payload with an embedded NUL keeps its full length
+    const char bin[] = {'a', '\0', 'b'};
+    Message c(bin, sizeof(bin));
+    assert(c.size() == 3 && c.view() == std::string_view(bin, 3));
+    Message d(std::string_view("view"));
+    assert(d.view() == "view");
+    std::string big(1000, 'x');
+    const char* data = big.data();
+    Message e(std::move(big));
+    assert(e.view().data() == data && e.size() == 1000); // moved in, not copied
 }
 
 static void test_MessageQueue() {
@@ -95,6 +1691,733 @@ static void test_MessageQueue() {
         delete m;
     }
     assert(q.dequeue() == nullptr);
+
+    // wraparound: advance head past slot 0, then grow while the live range is split
+    for (int i = 0; i < 10; ++i) q.enqueue(new Message("x"));
+    for (int i = 0; i < 10; ++i) delete q.dequeue();
+    int cap = q.getCapacity();
+    for (int i = 0; i < cap + 3; ++i) {
+        std::string s = "w" + std::to_string(i);
+        q.enqueue(new Message(s.c_str()));
+    }
+    assert(q.getCapacity() == cap * 2);
+    for (int i = 0; i < cap + 3; ++i) {
+        std::string expect = "w" + std::to_string(i);
+        Message* m = q.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expect.c_str()) == 0);
+        delete m;
+    }
+    assert(q.getSize() == 0);
+    q.enqueue(new Message("left for the destructor"));
+}
+
+static void test_BatchEnqueueDequeue() {
+    MessageQueue q;
+    q.enqueue(new Message("b0"));
+    delete q.dequeue(); // head off slot 0 so the batch wraps
+    std::vector<Message*> in;
+    for (int i = 0; i < 40; ++i) in.push_back(new Message(("b" + std::to_string(i)).c_str()));
+    q.enqueueBatch(in);
+    assert(q.getSize() == 40);
+    Message* out[64];
+    int n = q.dequeueBatch(out, 25);
+    assert(n == 25 && std::strcmp(out[24]->getMessage(), "b24") == 0);
+    for (int i = 0; i < n; ++i) delete out[i];
+    n = q.dequeueBatch(out, 64);
+    assert(n == 15 && std::strcmp(out[0]->getMessage(), "b25") == 0 && q.dequeueBatch(out + n, 64) == 0);
+    for (int i = 0; i < n; ++i) delete out[i];
+
+    // priority order holds across levels within one batch
+    MessagePriorityQueue pq;
+    Message* lows[] = {new Message("L1"), new Message("L2")};
+    Message* highs[] = {new Message("H1"), new Message("H2")};
+    pq.enqueueBatch(lows, MessagePriorityQueue::low);
+    pq.enqueueBatch(highs, MessagePriorityQueue::highest);
+    pq.enqueue(new Message("Hi1"), MessagePriorityQueue::high);
+    n = pq.dequeueBatch(out, 4);
+    const char* order[] = {"H1", "H2", "Hi1", "L1"};
+    assert(n == 4);
+    for (int i = 0; i < n; ++i) {
+        assert(std::strcmp(out[i]->getMessage(), order[i]) == 0);
+        delete out[i];
+    }
+    assert(pq.getSize() == 1 && pq.getServed(MessagePriorityQueue::highest) == 2);
+    // "L2" is freed by the destructor
+}
+
+static void test_MessageQueueShrink() {
+    MessageQueue q;
+    q.setShrinkAfter(8);
+    for (int i = 0; i < 1000; ++i) q.enqueue(new Message("burst"));
+    assert(q.getCapacity() == 1024);
+    for (int i = 0; i < 990; ++i) delete q.dequeue();
+    // each halving needs 8 pops in a row under 1/4 full, so capacity trails the drain
+    assert(q.getCapacity() < 1024 && q.getCapacity() >= 16);
+    for (int i = 0; i < 5; ++i) delete q.dequeue();
+    q.trim();
+    assert(q.getCapacity() == 8 && q.getSize() == 5);
+    for (int i = 0; i < 5; ++i) delete q.dequeue();
+    q.trim();
+    assert(q.getCapacity() == 0);
+    q.enqueue(new Message("again")); // still usable after trimming to nothing
+    assert(q.getCapacity() == 16);
+
+    MessagePriorityQueue pq;
+    pq.setShrinkAfter(1);
+    for (int i = 0; i < 100; ++i) pq.enqueue(new Message("p"), MessagePriorityQueue::low);
+    while (Message* m = pq.dequeue()) delete m;
+    pq.trim();
+    pq.enqueue(new Message("left for the destructor"), MessagePriorityQueue::low);
+}
+
+static void test_Reserve() {
+    // capacity holds at the reservation through fill/drain cycles, the shrink policy and trim
+    BasicMessageQueue<int> q;
+    q.reserve(1000);
+    q.setShrinkAfter(1);
+    assert(q.getCapacity() == 1024);
+    int v = 0;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 1000; ++i) q.enqueue(i);
+        while (q.try_pop(v)) {}
+    }
+    assert(q.getCapacity() == 1024 && v == 999);
+    q.trim();
+    assert(q.getCapacity() == 1024);
+
+    MessagePriorityQueue pq;
+    pq.reserve(MessagePriorityQueue::highest, 1000);
+    pq.reserve(MessagePriorityQueue::low, 100);
+    pq.setShrinkAfter(1);
+    std::vector<Message> pool(1000);
+    std::vector<Message*> in;
+    for (Message& m : pool) in.push_back(&m);
+    HeapMessagePriorityQueue<int> heap;
+    heap.reserve(64);
+#ifdef MPQ_TRACK_ALLOCS
+    std::size_t before = heapAllocations;
+#endif
+    // steady state inside the reservation, with the shrink policy armed
+    Message* out[1000];
+    for (int round = 0; round < 2; ++round) {
+        pq.enqueueBatch(in, MessagePriorityQueue::highest);
+        for (int i = 0; i < 100; ++i) pq.enqueue(pq.dequeue(), MessagePriorityQueue::low);
+        for (int i = 0; i < 500; ++i) pq.dequeue();
+        int n = pq.dequeueBatch(out, 1000);
+        assert(n == 500);
+    }
+    pq.trim(); // the reservation is also the trim floor
+
+    // a reserved heap recycles its entry vector as well
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 64; ++i) heap.enqueue(i, static_cast<std::uint64_t>(63 - i));
+        while (heap.try_pop(v)) {}
+    }
+#ifdef MPQ_TRACK_ALLOCS
+    assert(heapAllocations == before); // nothing above reached operator new
+#endif
+    assert(pq.empty() && v == 0);
+}
+
+static void test_MessageQueueCancel() {
+    MessageQueue q;
+    MessageQueue::Handle h[40];
+    for (int i = 0; i < 40; ++i) { // grows twice while handles are outstanding
+        std::string s = "c" + std::to_string(i);
+        h[i] = q.enqueue(new Message(s.c_str()));
+    }
+    Message* m = q.cancel(h[0]); // at the head
+    assert(m && std::strcmp(m->getMessage(), "c0") == 0);
+    delete m;
+    for (int i = 2; i < 40; i += 2) delete q.cancel(h[i]); // tombstones in the middle
+    assert(q.cancel(h[2]) == nullptr); // already cancelled
+    assert(q.getSize() == 20);
+    for (int i = 1; i < 40; i += 2) {
+        std::string expect = "c" + std::to_string(i);
+        m = q.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expect.c_str()) == 0);
+        delete m;
+    }
+    assert(q.dequeue() == nullptr && q.cancel(h[39]) == nullptr); // dequeued handles are dead too
+}
+
+static void test_IntrusiveMessagePriorityQueue() {
+    IntrusiveMessagePriorityQueue pq;
+    Message* l1 = new Message("L1");
+    Message* hi1 = new Message("Hi1");
+    pq.enqueue(l1, MessagePriorityQueue::low);
+    pq.enqueue(new Message("H1"), MessagePriorityQueue::highest);
+    pq.enqueue(hi1, MessagePriorityQueue::high);
+    pq.enqueue(new Message("L2"), MessagePriorityQueue::low);
+    pq.changePriority(l1, MessagePriorityQueue::low, MessagePriorityQueue::highest); // same object, relinked
+    pq.remove(hi1, MessagePriorityQueue::high);
+    delete hi1;
+    assert(pq.getSize() == 3 && pq.getSize(MessagePriorityQueue::high) == 0);
+    const char* order[] = {"H1", "L1"};
+    for (auto* expected : order) {
+        Message* m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    // "L2" is freed by the destructor
+}
+
+static void test_BasicMessageQueue() {
+    static_assert(!std::is_copy_constructible_v<Message> && std::is_nothrow_move_constructible_v<Message>);
+    BasicMessageQueue<Message> q;
+    // offset head first so the growth below relocates a wrapped range
+    for (int i = 0; i < 7; ++i) q.emplace("x");
+    Message out;
+    int drained = 0;
+    while (q.try_pop(out)) ++drained;
+    assert(drained == 7);
+    for (int i = 0; i < 40; ++i) q.emplace("v" + std::to_string(i)); // std::string&& moved in
+    assert(q.getSize() == 40);
+    for (int i = 0; i < 35; ++i) {
+        std::string expect = "v" + std::to_string(i);
+        out = Message();
+        [[maybe_unused]] bool ok = q.try_pop(out); // popped outside assert so NDEBUG builds still pop
+        assert(ok && out.view() == expect);
+    }
+    assert(q.front().view() == "v35");
+    // the remaining five are destroyed with the queue
+}
+
+static void test_BasicMessagePriorityQueue() {
+    // unboxed POD descriptors and a compile-time level count other than four
+    struct Task { int id; int level; };
+    BasicMessagePriorityQueue<Task, 8> pq;
+    static_assert(decltype(pq)::levels == 8);
+    const Task in[] = {{1, 7}, {2, 3}, {3, 0}, {4, 3}, {5, 7}};
+    for (const Task& t : in) pq.enqueue(t, t.level);
+    assert(pq.getSize() == 5 && pq.getSize(3) == 2);
+    const int order[] = {3, 2, 4, 1, 5};
+    for (int id : order) {
+        Task t{-1, -1};
+        [[maybe_unused]] bool ok = pq.try_pop(t);
+        assert(ok && t.id == id);
+    }
+    Task t{};
+    assert(!pq.try_pop(t));
+}
+
+static void test_MessagePriorityQueueHandles() {
+    MessagePriorityQueue pq;
+    auto l1 = pq.enqueue(new Message("L1"), MessagePriorityQueue::low);
+    pq.enqueue(new Message("H1"), MessagePriorityQueue::highest);
+    auto hi1 = pq.enqueue(new Message("Hi1"), MessagePriorityQueue::high);
+    pq.enqueue(new Message("L2"), MessagePriorityQueue::low);
+
+    l1 = pq.changePriority(l1, MessagePriorityQueue::highest); // joins the back of highest
+    Message* m = pq.cancel(hi1);
+    assert(m && std::strcmp(m->getMessage(), "Hi1") == 0);
+    delete m;
+    assert(pq.cancel(hi1) == nullptr);
+    assert(pq.getSize() == 3 && pq.getSize(MessagePriorityQueue::high) == 0 && pq.getSize(MessagePriorityQueue::low) == 1);
+
+    const char* order[] = {"H1", "L1", "L2"};
+    for (auto* expected : order) {
+        m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq.dequeue() == nullptr && pq.empty());
+    assert(pq.changePriority(l1, MessagePriorityQueue::low).level < 0); // gone already
+}
+
+static void test_WeightedFairDequeue() {
+    MessagePriorityQueue pq;
+    const unsigned w[] = {4, 2, 1, 1};
+    pq.setWeights(w);
+    pq.setDequeuePolicy(DequeuePolicy::weightedFair);
+    const char* tag[] = {"H", "Hi", "L", "Lo"};
+    for (int p = MessagePriorityQueue::highest; p <= MessagePriorityQueue::lowest; ++p)
+        for (int i = 0; i < 40; ++i) pq.enqueue(new Message(tag[p]), p);
+    // every round: 4 highest, 2 high, 1 low, 1 lowest
+    const char* round[] = {"H", "H", "H", "H", "Hi", "Hi", "L", "Lo"};
+    for (int r = 0; r < 5; ++r) {
+        for (auto* expected : round) {
+            Message* m = pq.dequeue();
+            assert(m && std::strcmp(m->getMessage(), expected) == 0);
+            delete m;
+        }
+    }
+    assert(pq.getServed(MessagePriorityQueue::highest) == 20 && pq.getServed(MessagePriorityQueue::lowest) == 5);
+    // strict mode resumes plain priority order
+    pq.setDequeuePolicy(DequeuePolicy::strict);
+    Message* m = pq.dequeue();
+    assert(std::strcmp(m->getMessage(), "H") == 0);
+    delete m;
+    // the remaining messages are freed by the destructor
+}
+
+static void test_AgingDequeue() {
+    // times are passed in rather than read from the clock, so ties and coarse clocks cannot
+    // change the order
+    using namespace std::chrono;
+    auto t0 = MessagePriorityQueue::clock::time_point{} + hours(1);
+    MessagePriorityQueue pq;
+    pq.enqueue(new Message("L0"), MessagePriorityQueue::low); // queued before aging: unstamped
+    pq.setDequeuePolicy(DequeuePolicy::aging, t0);             // ... so it counts as queued at t0
+    pq.setAgingThreshold(MessagePriorityQueue::low, milliseconds(10));
+    pq.enqueue(new Message("L1"), MessagePriorityQueue::low, t0 + milliseconds(1));
+    pq.enqueue(new Message("Hi1"), MessagePriorityQueue::high, t0 + milliseconds(2));
+    pq.enqueue(new Message("H1"), MessagePriorityQueue::highest, t0 + milliseconds(3));
+    pq.enqueue(new Message("Hi2"), MessagePriorityQueue::high, t0 + milliseconds(4));
+    // high never ages, so H1 goes first; at 5ms low is not aged yet, by 11ms both low heads
+    // are, and they are older than Hi2
+    struct Pop { milliseconds at; const char* expected; };
+    const Pop pops[] = {{milliseconds(5), "H1"}, {milliseconds(5), "Hi1"}, {milliseconds(11), "L0"},
+                        {milliseconds(11), "L1"}, {milliseconds(11), "Hi2"}};
+    for (const Pop& pop : pops) {
+        Message* m = pq.dequeue(t0 + pop.at);
+        assert(m && std::strcmp(m->getMessage(), pop.expected) == 0);
+        delete m;
+    }
+    assert(pq.dequeue(t0 + milliseconds(11)) == nullptr);
+}
+
+static void test_HierarchicalMessagePriorityQueue() {
+    auto pq = std::make_unique<HierarchicalMessagePriorityQueue<Message*, DeleteElements>>();
+    // levels chosen to straddle leaf-word and mid-word boundaries
+    const int lv[] = {65535, 4096, 63, 64, 0, 4096, 4095};
+    const char* name[] = {"z", "m1", "a63", "a64", "a0", "m2", "m0"};
+    for (int i = 0; i < 7; ++i) pq->enqueue(new Message(name[i]), lv[i]);
+    assert(pq->getSize() == 7 && pq->getSize(4096) == 2 && pq->getSize(1000) == 0);
+    assert(pq->getBucketCount() == 6); // only occupied levels got a bucket
+    assert(pq->topLevel() == 0);
+    const char* order[] = {"a0", "a63", "a64", "m0", "m1", "m2"};
+    for (auto* expected : order) {
+        Message* m = pq->dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq->topLevel() == 65535 && !pq->empty());
+    assert(pq->getBucketCount() == 1); // the five drained buckets were released on the way
+    pq->trim();
+    assert(pq->getBucketCount() == 1 && pq->getSize(65535) == 1);
+    // "z" is left for the destructor
+
+    // one message cycled through every level leaves nothing allocated behind it
+    HierarchicalMessagePriorityQueue<int> cycle;
+    int v = -1;
+    for (int p = 0; p < HierarchicalMessagePriorityQueue<int>::levels; ++p) {
+        cycle.enqueue(p, p);
+        [[maybe_unused]] bool ok = cycle.try_pop(v);
+        assert(ok && v == p && cycle.getBucketCount() == 0);
+    }
+    for (int p = 0; p < 4096; p += 3) cycle.enqueue(p, p);
+    assert(cycle.getBucketCount() == 1366);
+    while (cycle.try_pop(v)) {}
+    assert(cycle.getBucketCount() == 0 && cycle.empty());
+}
+
+static void test_HeapMessagePriorityQueue() {
+    HeapMessagePriorityQueue<Message*, 4, DeleteElements> pq;
+    // same shape as test_MessagePriorityQueue with deadlines as keys: equal keys stay FIFO
+    pq.enqueue(new Message("L1"), 900);
+    pq.enqueue(new Message("H1"), 10);
+    pq.enqueue(new Message("H2"), 10);
+    pq.enqueue(new Message("Hi1"), 500);
+    pq.enqueue(new Message("L2"), 900);
+    const char* order[] = {"H1","H2","Hi1","L1","L2"};
+    for (auto* expected : order) {
+        Message* m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq.dequeue() == nullptr);
+
+    // bulk construction: heap order by key, range order among equal keys
+    std::vector<std::pair<std::uint64_t, int>> in;
+    for (int i = 0; i < 100; ++i) in.emplace_back(static_cast<std::uint64_t>((i * 37) % 10), i);
+    HeapMessagePriorityQueue<int, 8> bulk(in.begin(), in.end());
+    assert(bulk.getSize() == 100);
+    std::uint64_t lastKey = 0;
+    int lastId = -1, v = 0;
+    while (!bulk.empty()) {
+        std::uint64_t k = bulk.topKey();
+        bulk.try_pop(v);
+        assert(k > lastKey || (k == lastKey && v > lastId));
+        lastKey = k;
+        lastId = v;
+    }
+}
+
+static void test_RadixMessagePriorityQueue() {
+    RadixMessagePriorityQueue<Message*, DeleteElements> pq;
+    pq.enqueue(new Message("t900a"), 900);
+    pq.enqueue(new Message("t10a"), 10);
+    pq.enqueue(new Message("t10b"), 10);
+    pq.enqueue(new Message("t500"), 500);
+    Message* m = pq.dequeue();
+    assert(std::strcmp(m->getMessage(), "t10a") == 0 && pq.lastKey() == 10);
+    delete m;
+    // keys at or after the last extracted one are accepted, ties stay in arrival order
+    pq.enqueue(new Message("t10c"), 10);
+    pq.enqueue(new Message("t900b"), 900);
+    pq.enqueue(new Message("t1u64"), std::uint64_t{1} << 63);
+    const char* order[] = {"t10b", "t10c", "t500", "t900a", "t900b"};
+    for (auto* expected : order) {
+        m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq.getSize() == 1); // the 2^63 one is left for the destructor
+}
+
+static void test_DelayedMessagePriorityQueue() {
+    using namespace std::chrono;
+    // origin an hour back from real time, so try_pop's clock::now() has reached every tick below
+    auto t0 = DelayedMessagePriorityQueue::clock::now() - hours(1);
+    DelayedMessagePriorityQueue pq(milliseconds(1), t0);
+    pq.enqueueAt(new Message("D10s"), MessagePriorityQueue::low, t0 + seconds(10));      // level 2
+    pq.enqueueAt(new Message("D5ms"), MessagePriorityQueue::lowest, t0 + milliseconds(5)); // level 0
+    auto h = pq.enqueueAt(new Message("D70ms"), MessagePriorityQueue::high, t0 + milliseconds(70));
+    pq.enqueueAt(new Message("D2h"), MessagePriorityQueue::highest, t0 + hours(2)); // never due here
+    pq.enqueue(new Message("now"), MessagePriorityQueue::lowest);
+    assert(pq.getSize() == 1 && pq.getPendingCount() == 4);
+
+    pq.poll(t0 + milliseconds(4));
+    assert(pq.getSize() == 1);
+    pq.poll(t0 + microseconds(4500)); // rounds up to tick 5
+    assert(pq.getSize() == 2 && pq.getSize(MessagePriorityQueue::lowest) == 2);
+
+    Message* m = nullptr;
+    pq.cancel(h, m);
+    assert(m && std::strcmp(m->getMessage(), "D70ms") == 0);
+    delete m;
+    m = nullptr;
+    pq.cancel(h, m); // a handle only works once
+    assert(m == nullptr && pq.getPendingCount() == 2);
+
+    pq.poll(t0 + seconds(10)); // cascades the 10s timer down through the levels
+    const char* order[] = {"D10s", "now", "D5ms"};
+    for (auto* expected : order) {
+        m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq.dequeue() == nullptr && pq.getPendingCount() == 1); // D2h is freed by the destructor
+
+    // messages due at the same time on one level come out first in, first out: scheduled
+    // straight into one level-0 slot, and when the first one reaches that slot by cascading
+    DelayedMessagePriorityQueue ties(milliseconds(1), t0);
+    ties.enqueueAt(new Message("A"), MessagePriorityQueue::low, t0 + milliseconds(5));
+    ties.enqueueAt(new Message("B"), MessagePriorityQueue::low, t0 + milliseconds(5));
+    ties.enqueueAt(new Message("C"), MessagePriorityQueue::low, t0 + milliseconds(5));
+    ties.enqueueAt(new Message("D"), MessagePriorityQueue::low, t0 + milliseconds(100)); // level 1
+    ties.poll(t0 + milliseconds(50));
+    ties.enqueueAt(new Message("E"), MessagePriorityQueue::low, t0 + milliseconds(100)); // level 0
+    ties.enqueueAt(new Message("F"), MessagePriorityQueue::low, t0 + milliseconds(100));
+    ties.poll(t0 + milliseconds(100));
+    for (const char* expected : {"A", "B", "C", "D", "E", "F"}) {
+        m = ties.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+}
+
+static void test_CalendarMessagePriorityQueue() {
+    CalendarMessagePriorityQueue<Message*, DeleteElements> pq;
+    pq.enqueue(new Message("L1"), 9.0);
+    pq.enqueue(new Message("H1"), 0.5);
+    pq.enqueue(new Message("H2"), 0.5);
+    pq.enqueue(new Message("Hi1"), 3.25);
+    pq.enqueue(new Message("L2"), 9.0);
+    assert(pq.getSize() == 5);
+    const char* order[] = {"H1","H2","Hi1","L1","L2"};
+    for (auto* expected : order) {
+        Message* m = pq.dequeue();
+        assert(m && std::strcmp(m->getMessage(), expected) == 0);
+        delete m;
+    }
+    assert(pq.dequeue() == nullptr);
+
+    // event-list hold model across several resizes, with an occasional event in the past
+    CalendarMessagePriorityQueue<int> events;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> gap(0.0, 2.0);
+    for (int i = 0; i < 3000; ++i) events.enqueue(i, gap(rng) * 100);
+    double now = 0;
+    for (int i = 0; i < 20000; ++i) {
+        double t = events.topTime();
+        assert(t >= now);
+        int v;
+        events.try_pop(v);
+        now = t;
+        if (i % 10) events.enqueue(v, now + gap(rng));
+        if (i % 500 == 0) { events.enqueue(-1, now); now = events.topTime(); }
+    }
+    while (!events.empty()) {
+        double t = events.topTime();
+        assert(t >= now);
+        int v;
+        events.try_pop(v);
+        now = t;
+    }
+}
+
+static void test_ConcurrentMessagePriorityQueue() {
+    using namespace std::chrono;
+    ConcurrentMessagePriorityQueue pq;
+    assert(pq.tryDequeue() == nullptr);
+    auto t0 = steady_clock::now();
+    assert(pq.dequeueFor(milliseconds(5)) == nullptr);
+    assert(steady_clock::now() - t0 >= milliseconds(5));
+
+    pq.enqueue(new Message("low"), MessagePriorityQueue::low);
+    pq.enqueue(new Message("high"), MessagePriorityQueue::high);
+    Message* m = pq.dequeueWait();
+    assert(m && std::strcmp(m->getMessage(), "high") == 0);
+    delete m;
+
+    // a consumer blocked in dequeueWait is woken by the producer, not by a timeout
+    Message* got = nullptr;
+    std::thread waiter([&] { delete pq.dequeueWait(); got = pq.dequeueWait(); });
+    std::this_thread::sleep_for(milliseconds(2));
+    pq.enqueue(new Message("late"), MessagePriorityQueue::highest);
+    waiter.join();
+    assert(got && std::strcmp(got->getMessage(), "late") == 0); // "low" came out first
+    delete got;
+    assert(pq.empty());
+
+    // 4 producers x 2000 messages, 3 consumers: each message arrives exactly once
+    constexpr int producers = 4, consumers = 3, perProducer = 2000;
+    std::vector<int> seen(producers * perProducer, 0);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c)
+        threads.emplace_back([&] {
+            std::vector<int> mine;
+            while (Message* msg = pq.dequeueWait()) {
+                mine.push_back(std::stoi(msg->getMessage()));
+                delete msg;
+            }
+            static std::mutex merge;
+            std::lock_guard<std::mutex> held(merge);
+            for (int id : mine) ++seen[id];
+        });
+    std::vector<std::thread> senders;
+    for (int t = 0; t < producers; ++t)
+        senders.emplace_back([&pq, t] {
+            for (int i = 0; i < perProducer; ++i) {
+                std::string id = std::to_string(t * perProducer + i);
+                pq.enqueue(new Message(id.c_str()), i % 4);
+            }
+        });
+    for (auto& th : senders) th.join();
+    pq.close(); // consumers drain what is left, then return nullptr
+    for (auto& th : threads) th.join();
+    assert(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+    assert(pq.isClosed() && pq.dequeueFor(seconds(1)) == nullptr);
+}
+
+static void test_SpscMessageQueue() {
+    SpscMessageQueue q(5);
+    assert(q.getCapacity() == 8 && q.empty());
+    Message* ms[8];
+    for (int i = 0; i < 8; ++i) {
+        ms[i] = new Message(std::to_string(i).c_str());
+        [[maybe_unused]] bool ok = q.try_enqueue(ms[i]); // outside assert so NDEBUG builds still enqueue
+        assert(ok);
+    }
+    Message* extra = new Message("x");
+    [[maybe_unused]] bool taken = q.try_enqueue(extra);
+    assert(!taken && q.getSize() == 8); // full: nothing taken
+    for (int i = 0; i < 3; ++i) {
+        Message* m = q.dequeue();
+        assert(m == ms[i]);
+        delete m;
+    }
+    taken = q.try_enqueue(extra);
+    assert(taken); // wraps into freed slots
+    Message* out[16];
+    int n = q.dequeueBatch(out, -1); // a negative count takes nothing
+    assert(n == 0 && q.getSize() == 6);
+    n = q.dequeueBatch(out, 16);
+    assert(n == 6 && out[0] == ms[3] && out[5] == extra);
+    for (int i = 0; i < n; ++i) delete out[i];
+    assert(q.dequeue() == nullptr);
+
+    // one producer thread, one consumer thread: FIFO order survives the handoff
+    constexpr int total = 200000;
+    BasicSpscMessageQueue<int> ints(64);
+    std::thread producer([&] {
+        for (int i = 0; i < total; ++i)
+            while (!ints.try_enqueue(i)) std::this_thread::yield();
+    });
+    int expected = 0;
+    while (expected < total) {
+        int v;
+        if (!ints.try_pop(v)) { std::this_thread::yield(); continue; }
+        assert(v == expected);
+        ++expected;
+    }
+    producer.join();
+    assert(ints.empty());
+
+    q.try_enqueue(new Message("left")); // freed by the destructor
+}
+
+static void test_MpmcMessageQueue() {
+    MpmcMessageQueue q(3);
+    assert(q.getCapacity() == 4 && q.empty());
+    Message* ms[4];
+    for (int i = 0; i < 4; ++i) {
+        ms[i] = new Message(std::to_string(i).c_str());
+        [[maybe_unused]] bool ok = q.try_enqueue(ms[i]); // outside assert so NDEBUG builds still enqueue
+        assert(ok);
+    }
+    Message* extra = new Message("x");
+    [[maybe_unused]] bool taken = q.try_enqueue(extra);
+    assert(!taken && q.getSize() == 4);
+    Message* m = q.dequeue();
+    assert(m == ms[0]);
+    delete m;
+    q.enqueue(extra); // takes the freed cell on its second lap
+    for (int i = 1; i < 4; ++i) {
+        m = q.dequeue();
+        assert(m == ms[i]);
+        delete m;
+    }
+    m = q.dequeue();
+    assert(m == extra);
+    delete m;
+    assert(q.dequeue() == nullptr);
+
+    // 4 producers, 4 consumers: every value arrives exactly once, and each producer's
+    // values arrive in the order it sent them
+    constexpr int producers = 4, consumers = 4, perProducer = 20000;
+    BasicMpmcMessageQueue<int> ints(64);
+    std::atomic<int> received{0};
+    std::vector<std::vector<int>> got(consumers);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t)
+        threads.emplace_back([&ints, t] {
+            for (int i = 0; i < perProducer; ++i) ints.enqueue(t * perProducer + i);
+        });
+    for (int c = 0; c < consumers; ++c)
+        threads.emplace_back([&, c] {
+            int v;
+            while (received.load() < producers * perProducer)
+                if (ints.try_pop(v)) { got[c].push_back(v); ++received; }
+                else std::this_thread::yield();
+        });
+    for (auto& th : threads) th.join();
+    std::vector<int> seen(producers * perProducer, 0);
+    for (auto& mine : got) {
+        std::vector<int> last(producers, -1);
+        for (int v : mine) {
+            ++seen[v];
+            assert(v > last[v / perProducer]);
+            last[v / perProducer] = v;
+        }
+    }
+    assert(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+    assert(ints.empty());
+
+    q.enqueue(new Message("left")); // freed by the destructor
+}
+
+static void test_IntrusiveMpscMessageQueue() {
+    IntrusiveMpscMessageQueue box;
+    assert(box.empty() && box.dequeue() == nullptr);
+    Message* a = new Message("a");
+    Message* b = new Message("b");
+    box.enqueue(a);
+    box.enqueue(b);
+    assert(!box.empty());
+    // dequeued outside assert so NDEBUG builds still unlink them before a is re-queued
+    [[maybe_unused]] Message* first = box.dequeue();
+    [[maybe_unused]] Message* second = box.dequeue();
+    [[maybe_unused]] Message* none = box.dequeue();
+    assert(first == a && second == b && none == nullptr);
+    box.enqueue(a); // the stub is cycled back in each time the list runs dry
+    first = box.dequeue();
+    assert(first == a && box.empty());
+
+    IntrusiveMessageQueue plain; // a dequeued message is unlinked and can join another list
+    plain.enqueue(a);
+    plain.enqueue(b);
+
+    // 4 senders, the owner receiving concurrently: each message arrives exactly once,
+    // in the order its sender sent it
+    constexpr int senders = 4, perSender = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < senders; ++t)
+        threads.emplace_back([&box, t] {
+            for (int i = 0; i < perSender; ++i) box.enqueue(new Message(std::to_string(t * perSender + i)));
+        });
+    std::vector<int> last(senders, -1);
+    for (int received = 0; received < senders * perSender;) {
+        Message* m = box.dequeue();
+        if (!m) { std::this_thread::yield(); continue; }
+        int id = std::stoi(m->getMessage());
+        assert(id > last[id / perSender]);
+        last[id / perSender] = id;
+        delete m;
+        ++received;
+    }
+    for (auto& th : threads) th.join();
+    assert(box.empty());
+    box.enqueue(new Message("left")); // freed by the destructor
+}
+
+static void test_LockFreeMessagePriorityQueue() {
+    LockFreeMessagePriorityQueue pq(2);
+    assert(pq.empty() && pq.dequeue() == nullptr);
+    Message* lo = new Message("lowest");
+    Message* h1 = new Message("high 1");
+    Message* h2 = new Message("high 2");
+    Message* top = new Message("highest");
+    pq.enqueue(lo, MessagePriorityQueue::lowest);
+    pq.enqueue(h1, MessagePriorityQueue::high);
+    pq.enqueue(h2, MessagePriorityQueue::high);
+    [[maybe_unused]] bool taken = pq.try_enqueue(top, MessagePriorityQueue::high); // outside assert for NDEBUG
+    assert(!taken); // that level is full
+    pq.enqueue(top, MessagePriorityQueue::highest);
+    assert(pq.getSize() == 4 && pq.getSize(MessagePriorityQueue::high) == 2);
+    Message* order[] = {top, h1, h2, lo};
+    for (Message* expected : order) {
+        Message* m = pq.dequeue();
+        assert(m == expected);
+        delete m;
+    }
+    assert(pq.dequeue() == nullptr && pq.empty());
+
+    // one producer per level and 3 consumers racing on the ready mask: no message is lost or
+    // stranded behind a cleared bit (the consumers would spin forever), none arrives twice
+    constexpr int consumers = 3, perLevel = 20000;
+    constexpr int levels = LockFreeMessagePriorityQueue::levels;
+    BasicLockFreeMessagePriorityQueue<int, levels> ints(64);
+    std::atomic<int> received{0};
+    std::vector<std::vector<int>> got(consumers);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < levels; ++p)
+        threads.emplace_back([&ints, p] {
+            for (int i = 0; i < perLevel; ++i) ints.enqueue(p * perLevel + i, p);
+        });
+    for (int c = 0; c < consumers; ++c)
+        threads.emplace_back([&, c] {
+            int v;
+            while (received.load() < levels * perLevel)
+                if (ints.try_pop(v)) { got[c].push_back(v); ++received; }
+                else std::this_thread::yield();
+        });
+    for (auto& th : threads) th.join();
+    std::vector<int> seen(levels * perLevel, 0);
+    for (auto& mine : got) {
+        std::vector<int> last(levels, -1);
+        for (int v : mine) {
+            ++seen[v];
+            assert(v > last[v / perLevel]); // FIFO within a level
+            last[v / perLevel] = v;
+        }
+    }
+    assert(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+    assert(ints.empty());
+
+    pq.enqueue(new Message("left"), MessagePriorityQueue::low); // freed by the destructor
 }
 
 static void test_MessagePriorityQueue() {
@@ -105,7 +2428,7 @@ static void test_MessagePriorityQueue() {
     pq.enqueue(new Message("Hi1"), MessagePriorityQueue::high);
     pq.enqueue(new Message("L2"), MessagePriorityQueue::low);
 
-    assert(pq.getSize() == 5);
+    assert(pq.getSize() == 5 && !pq.empty());
     const char* order[] = {"H1","H2","Hi1","L1","L2"};
     for (auto* expected : order) {
         Message* m = pq.dequeue();
@@ -113,14 +2436,403 @@ static void test_MessagePriorityQueue() {
         assert(std::strcmp(m->getMessage(), expected) == 0);
         delete m;
     }
-    assert(pq.dequeue() == nullptr);
+    assert(pq.dequeue() == nullptr && pq.empty());
+
+    // the ready mask follows levels emptying and refilling
+    pq.enqueue(new Message("Lo1"), MessagePriorityQueue::lowest);
+    Message* m = pq.dequeue();
+    assert(std::strcmp(m->getMessage(), "Lo1") == 0 && pq.empty());
+    delete m;
+    pq.enqueue(new Message("Lo2"), MessagePriorityQueue::lowest);
+    pq.enqueue(new Message("Hi2"), MessagePriorityQueue::high);
+    m = pq.dequeue();
+    assert(std::strcmp(m->getMessage(), "Hi2") == 0);
+    delete m;
+    m = pq.dequeue();
+    assert(std::strcmp(m->getMessage(), "Lo2") == 0 && pq.empty());
+    delete m;
+}
+
+// ===== Benchmarks (g++ -std=c++20 -O2 -DMPQ_BENCH) =====
+#ifdef MPQ_BENCH
+template <class F>
+static double nsPerOp(long long ops, F&& f) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(ops);
+}
+
+// fill to depth n, cycle n messages at that depth, then drain; per-op cost should stay flat in n.
+static void bench_MessageQueue() {
+    std::vector<Message> pool(1024);
+    std::cout << "MessageQueue          depth   fill ns/op   cycle ns/op   drain ns/op\n";
+    for (long long n = 10; n <= 10000000; n *= 10) {
+        long long rounds = std::max(1LL, 10000000 / n);
+        MessageQueue q;
+        double fill = 0, cycle = 0, drain = 0;
+        for (long long r = 0; r < rounds; ++r) {
+            fill += nsPerOp(n, [&] { for (long long i = 0; i < n; ++i) q.enqueue(&pool[i & 1023]); });
+            cycle += nsPerOp(n, [&] { for (long long i = 0; i < n; ++i) q.enqueue(q.dequeue()); });
+            drain += nsPerOp(n, [&] { for (long long i = 0; i < n; ++i) q.dequeue(); });
+        }
+        std::printf("%28lld %12.2f %13.2f %13.2f\n", n, fill / rounds, cycle / rounds, drain / rounds);
+    }
+}
+
+// the test_MessageQueue pattern (new Message per enqueue) against messages stored by value
+static void bench_BasicMessageQueue() {
+    const long long n = 1000000;
+    MessageQueue pq;
+    BasicMessageQueue<Message> vq;
+    double boxed = nsPerOp(n, [&] {
+        for (long long i = 0; i < n; ++i) pq.enqueue(new Message("payload"));
+        while (Message* m = pq.dequeue()) delete m;
+    });
+    double byValue = nsPerOp(n, [&] {
+        Message out;
+        for (long long i = 0; i < n; ++i) vq.emplace("payload");
+        while (vq.try_pop(out)) {}
+    });
+    std::printf("Message* + new/delete %8.2f ns/msg   BasicMessageQueue<Message> %8.2f ns/msg\n", boxed, byValue);
+}
+
+// 10^6 random 64-bit keys pushed then popped: 4-ary heap with FIFO tiebreak vs std::priority_queue
+static void bench_HeapMessagePriorityQueue() {
+    const int n = 1000000;
+    std::mt19937_64 rng(42);
+    std::vector<std::uint64_t> keys(n);
+    for (auto& k : keys) k = rng();
+    HeapMessagePriorityQueue<int, 4> dary;
+    dary.reserve(n);
+    double d4 = nsPerOp(2LL * n, [&] {
+        for (int i = 0; i < n; ++i) dary.enqueue(i, keys[i]);
+        int v;
+        while (dary.try_pop(v)) {}
+    });
+    using Item = std::tuple<std::uint64_t, std::uint64_t, int>; // key, seq, value
+    std::vector<Item> storage;
+    storage.reserve(n);
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> binary(std::greater<Item>(), std::move(storage));
+    double d2 = nsPerOp(2LL * n, [&] {
+        for (int i = 0; i < n; ++i) binary.emplace(keys[i], static_cast<std::uint64_t>(i), i);
+        while (!binary.empty()) binary.pop();
+    });
+    std::printf("1e6 keys: 4-ary heap %8.2f ns/op   std::priority_queue %8.2f ns/op\n", d4, d2);
+}
+
+// timestamp hold model: 10^4 pending events, each pop reschedules at now + [1, 1024].
+// the payload is the key itself; keys stay below 2^16 so the hierarchical bucket queue
+// can take them as levels directly.
+static void bench_RadixMessagePriorityQueue() {
+    const int pending = 10000, holds = 1000000;
+    std::mt19937_64 rng(7);
+    std::vector<std::uint64_t> delta(holds);
+    for (auto& d : delta) d = 1 + rng() % 1024;
+    auto hold = [&](auto& q, auto push) {
+        return nsPerOp(holds, [&] {
+            std::uint64_t now = 0;
+            for (int i = 0; i < pending; ++i) push(q, delta[i]);
+            for (int i = 0; i < holds; ++i) {
+                q.try_pop(now);
+                push(q, now + delta[i]);
+            }
+            while (q.try_pop(now)) {}
+        });
+    };
+    auto keyed = [](auto& q, std::uint64_t k) { q.enqueue(k, k); };
+    auto leveled = [](auto& q, std::uint64_t k) { q.enqueue(k, static_cast<int>(k)); };
+    RadixMessagePriorityQueue<std::uint64_t> radix;
+    HeapMessagePriorityQueue<std::uint64_t, 4> heap;
+    auto buckets = std::make_unique<HierarchicalMessagePriorityQueue<std::uint64_t>>();
+    double r = hold(radix, keyed);
+    double h = hold(heap, keyed);
+    double b = hold(*buckets, leveled);
+    std::printf("timestamp holds: radix %8.2f ns/op   4-ary heap %8.2f ns/op   2^16 buckets %8.2f ns/op\n", r, h, b);
+}
+
+// classic hold model on an event list of n events with exponential increments; the calendar
+// queue's cost per hold should stay flat in n while the heap's grows with log n
+static void bench_CalendarMessagePriorityQueue() {
+    const int holds = 1000000;
+    std::mt19937_64 rng(11);
+    std::exponential_distribution<double> inc(1.0);
+    std::vector<double> delta(holds);
+    for (auto& d : delta) d = inc(rng);
+    std::cout << "event holds            events   calendar ns/op   4-ary heap ns/op\n";
+    for (int n = 100000; n <= 10000000; n *= 10) {
+        double cal, heap;
+        {
+            CalendarMessagePriorityQueue<int> q;
+            for (int i = 0; i < n; ++i) q.enqueue(i, inc(rng) * n);
+            cal = nsPerOp(holds, [&] {
+                for (int i = 0; i < holds; ++i) {
+                    double t = q.topTime();
+                    int v;
+                    q.try_pop(v);
+                    q.enqueue(v, t + delta[i] * n);
+                }
+            });
+        }
+        {
+            HeapMessagePriorityQueue<int, 4> q;
+            q.reserve(n);
+            for (int i = 0; i < n; ++i) q.enqueue(i, static_cast<std::uint64_t>(inc(rng) * n * 1e6));
+            heap = nsPerOp(holds, [&] {
+                for (int i = 0; i < holds; ++i) {
+                    std::uint64_t t = q.topKey();
+                    int v;
+                    q.try_pop(v);
+                    q.enqueue(v, t + static_cast<std::uint64_t>(delta[i] * n * 1e6));
+                }
+            });
+        }
+        std::printf("%31d %16.2f %18.2f\n", n, cal, heap);
+    }
+}
+
+// consumer loop in batches of 64 against one call per message, on a four-level queue
+static void bench_Batch() {
+    const int n = 1 << 20, batch = 64;
+    std::vector<Message> pool(1024);
+    std::vector<Message*> in(n);
+    for (int i = 0; i < n; ++i) in[i] = &pool[i & 1023];
+    BasicMessagePriorityQueue<Message*, 4> pq;
+    Message* out[batch];
+    for (int i = 0; i < n; ++i) pq.enqueue(in[i], i & 3); // warm up: both runs start at full capacity
+    while (pq.dequeue()) {}
+    double single = nsPerOp(n, [&] {
+        for (int i = 0; i < n; ++i) pq.enqueue(in[i], i & 3);
+        while (pq.dequeue()) {}
+    });
+    double batched = nsPerOp(n, [&] {
+        for (int i = 0; i < n; i += batch) pq.enqueueBatch(std::span<Message*>(in.data() + i, batch), (i / batch) & 3);
+        while (pq.dequeueBatch(out, batch)) {}
+    });
+    std::printf("MessagePriorityQueue: one at a time %6.2f ns/msg   batches of %d %6.2f ns/msg\n", single, batch, batched);
+}
+
+// one producer thread hands n messages to one consumer thread: the lock-free SPSC ring (one at a
+// time and in batches of 64) against a MessageQueue behind a std::mutex. both sides spin with
+// yield when the queue is full or empty, so on a single core the numbers measure handoffs.
+static void bench_SpscMessageQueue() {
+    const long long n = 20000000;
+    Message token("payload");
+    auto run = [&](auto&& produce, auto&& consume) {
+        double ns = nsPerOp(n, [&] {
+            std::thread producer(produce);
+            consume();
+            producer.join();
+        });
+        return 1e3 / ns; // millions of messages per second
+    };
+    BasicSpscMessageQueue<Message*> ring(4096);
+    double spsc = run([&] {
+        for (long long i = 0; i < n; ++i)
+            while (!ring.try_enqueue(&token)) std::this_thread::yield();
+    }, [&] {
+        Message* m;
+        for (long long i = 0; i < n; ++i)
+            while (!ring.try_pop(m)) std::this_thread::yield();
+    });
+    double spscBatch = run([&] {
+        Message* in[64];
+        std::fill(in, in + 64, &token);
+        for (long long i = 0; i < n;) {
+            std::size_t k = ring.enqueueBatch(std::span<Message*>(in, std::min<long long>(64, n - i)));
+            if (!k) std::this_thread::yield();
+            i += static_cast<long long>(k);
+        }
+    }, [&] {
+        Message* out[64];
+        for (long long i = 0; i < n;) {
+            int k = ring.dequeueBatch(out, 64);
+            if (!k) std::this_thread::yield();
+            i += k;
+        }
+    });
+    std::mutex lock;
+    BasicMessageQueue<Message*> locked;
+    locked.reserve(4096);
+    double mutexed = run([&] {
+        for (long long i = 0; i < n; ++i) {
+            std::lock_guard<std::mutex> held(lock);
+            locked.enqueue(&token);
+        }
+    }, [&] {
+        Message* m;
+        for (long long i = 0; i < n;) {
+            bool got;
+            {
+                std::lock_guard<std::mutex> held(lock);
+                got = locked.try_pop(m);
+            }
+            if (got) ++i; else std::this_thread::yield();
+        }
+    });
+    std::printf("1 producer -> 1 consumer: SPSC ring %7.1f M msg/s   SPSC batches of 64 %7.1f M msg/s   mutex + MessageQueue %7.1f M msg/s\n",
+                spsc, spscBatch, mutexed);
+}
+
+// t threads each alternate enqueue and dequeue on one shared FIFO, 2^22 operations in all:
+// the MPMC ring against a MessageQueue behind a std::mutex, for t = 1, 2, 4, .., 64.
+// more threads than cores measures the cost of preemption on each design as well.
+static void bench_MpmcMessageQueue() {
+    const long long ops = 1LL << 22;
+    Message token("payload");
+    auto run = [&](int threads, auto&& push, auto&& pop) {
+        double ns = nsPerOp(ops, [&] {
+            std::vector<std::thread> pool;
+            for (int t = 0; t < threads; ++t)
+                pool.emplace_back([&] {
+                    for (long long i = 0; i < ops / 2 / threads; ++i) {
+                        push(&token);
+                        while (!pop()) std::this_thread::yield();
+                    }
+                });
+            for (auto& th : pool) th.join();
+        });
+        return 1e3 / ns; // millions of operations per second
+    };
+    std::cout << "shared FIFO  threads   MPMC ring M ops/s   mutex + MessageQueue M ops/s\n";
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        BasicMpmcMessageQueue<Message*> ring(1024);
+        double mpmc = run(threads, [&](Message* m) { ring.enqueue(m); }, [&] {
+            Message* m;
+            return ring.try_pop(m);
+        });
+        std::mutex lock;
+        BasicMessageQueue<Message*> locked;
+        double mutexed = run(threads, [&](Message* m) {
+            std::lock_guard<std::mutex> held(lock);
+            locked.enqueue(m);
+        }, [&] {
+            Message* m;
+            std::lock_guard<std::mutex> held(lock);
+            return locked.try_pop(m);
+        });
+        std::printf("%21d %19.1f %30.1f\n", threads, mpmc, mutexed);
+    }
+}
+
+// actor mailbox: 4 sender threads post 2^20 distinct messages each to one owner thread.
+// the intrusive MPSC list against a std::vector<Message*> behind a std::mutex that the owner
+// swaps out whole, which is the cheapest locked mailbox.
+static void bench_IntrusiveMpscMessageQueue() {
+    const int senders = 4, perSender = 1 << 20;
+    const long long n = static_cast<long long>(senders) * perSender;
+    std::vector<Message> pool(n);
+    auto run = [&](auto&& send, auto&& receiveSome) {
+        double ns = nsPerOp(n, [&] {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < senders; ++t)
+                threads.emplace_back([&, t] {
+                    for (int i = 0; i < perSender; ++i) send(&pool[static_cast<std::size_t>(t) * perSender + i]);
+                });
+            for (long long got = 0; got < n;) {
+                long long k = receiveSome();
+                if (!k) std::this_thread::yield();
+                got += k;
+            }
+            for (auto& th : threads) th.join();
+        });
+        return 1e3 / ns; // millions of messages per second
+    };
+    IntrusiveMpscMessageQueue box;
+    double mpsc = run([&](Message* m) { box.enqueue(m); }, [&] {
+        long long k = 0;
+        while (box.dequeue()) ++k;
+        return k;
+    });
+    std::mutex lock;
+    std::vector<Message*> inbox, taken;
+    double locked = run([&](Message* m) {
+        std::lock_guard<std::mutex> held(lock);
+        inbox.push_back(m);
+    }, [&] {
+        taken.clear();
+        {
+            std::lock_guard<std::mutex> held(lock);
+            inbox.swap(taken);
+        }
+        return static_cast<long long>(taken.size());
+    });
+    std::printf("4 senders -> 1 owner: intrusive MPSC %7.1f M msg/s   mutex + std::vector %7.1f M msg/s\n", mpsc, locked);
+}
+
+// one producer per level and 4 consumers, 2^20 messages per level: the lock-free lanes against
+// the mutex-and-condition-variable ConcurrentMessagePriorityQueue (consumers use tryDequeue)
+static void bench_LockFreeMessagePriorityQueue() {
+    constexpr int levels = 4, consumers = 4, perLevel = 1 << 20;
+    const long long n = static_cast<long long>(levels) * perLevel;
+    Message token("payload");
+    auto run = [&](auto&& send, auto&& receive) {
+        std::atomic<long long> received{0};
+        double ns = nsPerOp(n, [&] {
+            std::vector<std::thread> threads;
+            for (int p = 0; p < levels; ++p)
+                threads.emplace_back([&, p] { for (int i = 0; i < perLevel; ++i) send(&token, p); });
+            for (int c = 0; c < consumers; ++c)
+                threads.emplace_back([&] {
+                    while (received.load(std::memory_order_relaxed) < n)
+                        if (receive()) received.fetch_add(1, std::memory_order_relaxed);
+                        else std::this_thread::yield();
+                });
+            for (auto& th : threads) th.join();
+        });
+        return 1e3 / ns; // millions of messages per second
+    };
+    BasicLockFreeMessagePriorityQueue<Message*, levels> lanes(4096);
+    double lockFree = run([&](Message* m, int p) { lanes.enqueue(m, p); }, [&] {
+        Message* m;
+        return lanes.try_pop(m);
+    });
+    BasicConcurrentMessagePriorityQueue<Message*, levels> locked;
+    double mutexed = run([&](Message* m, int p) { locked.enqueue(m, p); }, [&] { return locked.tryDequeue() != nullptr; });
+    std::printf("4 levels x 1 producer -> 4 consumers: lock-free lanes %7.1f M msg/s   mutex + condvar %7.1f M msg/s\n",
+                lockFree, mutexed);
 }
+#endif
 
 int main() {
     test_Message();
     test_MessageQueue();
+    test_BatchEnqueueDequeue();
+    test_MessageQueueShrink();
+    test_Reserve();
+    test_MessageQueueCancel();
+    test_IntrusiveMessagePriorityQueue();
+    test_BasicMessageQueue();
+    test_BasicMessagePriorityQueue();
     test_MessagePriorityQueue();
+    test_MessagePriorityQueueHandles();
+    test_WeightedFairDequeue();
+    test_AgingDequeue();
+    test_HierarchicalMessagePriorityQueue();
+    test_HeapMessagePriorityQueue();
+    test_RadixMessagePriorityQueue();
+    test_CalendarMessagePriorityQueue();
+    test_DelayedMessagePriorityQueue();
+    test_ConcurrentMessagePriorityQueue();
+    test_SpscMessageQueue();
+    test_MpmcMessageQueue();
+    test_IntrusiveMpscMessageQueue();
+    test_LockFreeMessagePriorityQueue();
     std::cout << "All C++ tests passed.\n";
+#ifdef MPQ_BENCH
+    bench_MessageQueue();
+    bench_BasicMessageQueue();
+    bench_Batch();
+    bench_HeapMessagePriorityQueue();
+    bench_RadixMessagePriorityQueue();
+    bench_CalendarMessagePriorityQueue();
+    bench_SpscMessageQueue();
+    bench_MpmcMessageQueue();
+    bench_IntrusiveMpscMessageQueue();
+    bench_LockFreeMessagePriorityQueue();
+#endif
     return 0;
     //g++ -std=c++20 -O2 -Wall -Wextra -o mpq_cpp mpq.cpp
+    //g++ -std=c++20 -O2 -DMPQ_BENCH -o mpq_bench mpq.cpp
+    //g++ -std=c++20 -O2 -DMPQ_TRACK_ALLOCS -o mpq_cpp mpq.cpp   (also checks allocation counts)
 }
\ No newline at end of file